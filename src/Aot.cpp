@@ -0,0 +1,546 @@
+// Aot.cpp
+//
+// chip8_aot: static recompiler. Walks the code reachable from START_ADDRESS in a
+// ROM and emits a C++ translation unit for use with Chip8::RunStatic(). All
+// basic blocks go into one function, so a block whose successor is known at
+// generation time jumps straight to it with goto; only computed targets (00EE,
+// Bnnn) go through a switch on pc.
+
+#include "Chip8.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Number of required command-line arguments
+const int REQUIRED_ARGS = 3;
+
+// Prefix of the optional quirk policy argument
+const char QUIRKS_OPTION[] = "--quirks=";
+
+char const* const VARIANT_NAMES[] = {"Modern", "Cosmac", "SuperChip", "XoChip"};
+
+// Longest block emitted; longer straight-line runs are split
+const unsigned int MAX_BLOCK_LENGTH = 64;
+
+struct Rom
+{
+    std::vector<uint8_t> image;
+
+    bool Contains(unsigned int address) const
+    {
+        return address >= START_ADDRESS && address + 1 < START_ADDRESS + image.size();
+    }
+
+    uint16_t Fetch(unsigned int address) const
+    {
+        return (image[address - START_ADDRESS] << 8u) | image[address + 1 - START_ADDRESS];
+    }
+};
+
+struct BlockCode
+{
+    unsigned int length;
+    std::string body;
+    std::string tail;       // Runs only the first budget instructions, for a budget shorter than the block
+    std::vector<size_t> bodySteps;  // Where instruction i begins in body and in tail
+    std::vector<size_t> tailSteps;
+};
+
+// Reachable blocks by start address; known only after discovery
+using BlockSet = std::set<unsigned int>;
+
+std::string hex(unsigned int value, int digits)
+{
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "0x%0*X", digits, value);
+    return buffer;
+}
+
+// C++ string literal for arbitrary bytes, such as a file name; quotes,
+// backslashes and anything outside printable ASCII are escaped in octal
+std::string quote(std::string const& text)
+{
+    std::string literal = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+            literal += static_cast<char>(c);
+        } else if (c < 0x20 || c >= 0x7F) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\%03o", c);
+            literal += buffer;
+        } else {
+            literal += static_cast<char>(c);
+        }
+    }
+    return literal + "\"";
+}
+
+bool isTerminator(uint16_t opcode)
+{
+    switch (opcode & 0xF000u) {
+        case 0x0000: return opcode == 0x00EE;
+        case 0x1000:
+        case 0x2000:
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xB000: return true;
+        case 0xE000: return (opcode & 0xFFu) == 0x9E || (opcode & 0xFFu) == 0xA1;
+        case 0xF000: return (opcode & 0xFFu) == 0x33 || (opcode & 0xFFu) == 0x55;
+        default: return false;
+    }
+}
+
+bool isKeyWait(uint16_t opcode)
+{
+    return (opcode & 0xF0FFu) == 0xF00A;
+}
+
+// Translates the block at start and records its successors. With the set of
+// compiled blocks given, transfers to them become gotos; anything else, and
+// every transfer during discovery, returns to the runner.
+template <typename Quirks>
+BlockCode translateBlock(Rom const& rom, unsigned int start, std::vector<unsigned int>& successors, BlockSet const* compiled)
+{
+    std::ostringstream out;
+    std::vector<std::streamoff> steps;  // Where each instruction's code begins
+    unsigned int length = 0;
+    unsigned int address = start;
+    bool terminated = false;
+
+    // The block retires all its instructions before control leaves it
+    auto retire = [&]() {
+        out << "    budget -= " << length << ";\n";
+    };
+
+    auto jump = [&](unsigned int target, char const* indent) {
+        if (compiled && compiled->count(target)) {
+            out << indent << "goto Block_" << hex(target, 3) << ";\n";
+        } else {
+            out << indent << "pc = " << hex(target, 3) << ";\n";
+            out << indent << "return budget;\n";
+        }
+    };
+
+    while (length < MAX_BLOCK_LENGTH && rom.Contains(address)) {
+        uint16_t opcode = rom.Fetch(address);
+        if (isKeyWait(opcode)) {
+            // Fx0A stays on the interpreter; execution resumes after it
+            successors.push_back(address + 2);
+            break;
+        }
+
+        unsigned int x = (opcode & 0x0F00u) >> 8u;
+        unsigned int y = (opcode & 0x00F0u) >> 4u;
+        unsigned int kk = opcode & 0x00FFu;
+        unsigned int nnn = opcode & 0x0FFFu;
+        unsigned int next = (address + 2) & 0xFFFFu;
+        std::string vx = "V[" + hex(x, 1) + "]";
+        std::string vy = "V[" + hex(y, 1) + "]";
+
+        steps.push_back(out.tellp());
+        out << "    // " << hex(address, 3) << ": " << hex(opcode, 4) << "\n";
+        ++length;
+
+        auto skip = [&](std::string const& condition) {
+            retire();
+            out << "    if (" << condition << ") {\n";
+            jump(next + 2, "        ");
+            out << "    }\n";
+            jump(next, "    ");
+            successors.push_back(next);
+            successors.push_back(next + 2);
+        };
+
+        // Draws may end the batch; leave the block right after them when asked to
+        auto stopCheck = [&]() {
+            out << "    if (StaticRom::Stopping(chip8)) {\n";
+            out << "        pc = " << hex(next, 3) << ";\n";
+            out << "        return budget - " << length << ";\n";
+            out << "    }\n";
+        };
+
+        switch (opcode & 0xF000u) {
+            case 0x0000:
+                if (opcode == 0x00E0) {
+                    out << "    StaticRom::Execute(chip8, " << hex(opcode, 4) << ");\n";
+                    stopCheck();
+                } else if (opcode == 0x00EE) {
+                    out << "    --sp;\n    pc = stack[sp % STACK_LEVELS];\n";
+                    retire();
+                    out << "    goto Dispatch;\n";
+                }
+                break;
+            case 0x1000:
+                retire();
+                jump(nnn, "    ");
+                successors.push_back(nnn);
+                break;
+            case 0x2000:
+                out << "    stack[sp % STACK_LEVELS] = " << hex(next, 3) << ";\n    ++sp;\n";
+                retire();
+                jump(nnn, "    ");
+                successors.push_back(nnn);
+                successors.push_back(next);
+                break;
+            case 0x3000: skip(vx + " == " + hex(kk, 2)); break;
+            case 0x4000: skip(vx + " != " + hex(kk, 2)); break;
+            case 0x5000: skip(vx + " == " + vy); break;
+            case 0x6000: out << "    " << vx << " = " << hex(kk, 2) << ";\n"; break;
+            case 0x7000: out << "    " << vx << " += " << hex(kk, 2) << ";\n"; break;
+            case 0x8000:
+                switch (opcode & 0x000Fu) {
+                    case 0x0: out << "    " << vx << " = " << vy << ";\n"; break;
+                    case 0x1: out << "    " << vx << " |= " << vy << ";\n"; break;
+                    case 0x2: out << "    " << vx << " &= " << vy << ";\n"; break;
+                    case 0x3: out << "    " << vx << " ^= " << vy << ";\n"; break;
+                    case 0x4:
+                        out << "    sum = " << vx << " + " << vy << ";\n";
+                        out << "    V[0xF] = (sum > 255u);\n";
+                        out << "    " << vx << " = sum & 0xFFu;\n";
+                        break;
+                    case 0x5:
+                        out << "    V[0xF] = (" << vx << " > " << vy << ");\n";
+                        out << "    " << vx << " -= " << vy << ";\n";
+                        break;
+                    case 0x6:
+                        if (Quirks::shiftReadsVy) {
+                            out << "    " << vx << " = " << vy << ";\n";
+                        }
+                        out << "    V[0xF] = " << vx << " & 0x1u;\n";
+                        out << "    " << vx << " >>= 1;\n";
+                        break;
+                    case 0x7:
+                        out << "    V[0xF] = (" << vy << " > " << vx << ");\n";
+                        out << "    " << vx << " = " << vy << " - " << vx << ";\n";
+                        break;
+                    case 0xE:
+                        if (Quirks::shiftReadsVy) {
+                            out << "    " << vx << " = " << vy << ";\n";
+                        }
+                        out << "    V[0xF] = (" << vx << " & 0x80u) >> 7u;\n";
+                        out << "    " << vx << " <<= 1;\n";
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case 0x9000: skip(vx + " != " + vy); break;
+            case 0xA000: out << "    I = " << hex(nnn, 3) << ";\n"; break;
+            case 0xB000:
+                // Computed jump: the switch on pc resolves the target at run time
+                out << "    pc = " << (Quirks::jumpUsesVx ? vx : "V[0x0]") << " + " << hex(nnn, 3) << ";\n";
+                retire();
+                out << "    goto Dispatch;\n";
+                break;
+            case 0xC000:
+                out << "    StaticRom::Execute(chip8, " << hex(opcode, 4) << ");\n";
+                break;
+            case 0xD000:
+                out << "    StaticRom::Execute(chip8, " << hex(opcode, 4) << ");\n";
+                stopCheck();
+                break;
+            case 0xE000:
+                if (kk == 0x9E) {
+                    skip("chip8.keypad[" + vx + " & 0xFu]");
+                } else if (kk == 0xA1) {
+                    skip("!chip8.keypad[" + vx + " & 0xFu]");
+                }
+                break;
+            case 0xF000:
+                switch (kk) {
+                    case 0x07:
+                        out << "    " << vx << " = StaticRom::DelayTimer(chip8);\n";
+                        break;
+                    case 0x15:
+                        out << "    StaticRom::DelayTimer(chip8) = " << vx << ";\n";
+                        break;
+                    case 0x18:
+                        out << "    StaticRom::SoundTimer(chip8) = " << vx << ";\n";
+                        break;
+                    case 0x1E: out << "    I += " << vx << ";\n"; break;
+                    case 0x29: out << "    I = FONTSET_START_ADDRESS + (5 * " << vx << ");\n"; break;
+                    case 0x65: out << "    StaticRom::Execute(chip8, " << hex(opcode, 4) << ");\n"; break;
+                    case 0x33:
+                    case 0x55:
+                        // May overwrite code; the next block's guard re-checks it
+                        out << "    StaticRom::Execute(chip8, " << hex(opcode, 4) << ");\n";
+                        retire();
+                        jump(next, "    ");
+                        successors.push_back(next);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+        }
+
+        address += 2;
+
+        if (isTerminator(opcode)) {
+            terminated = true;
+            break;
+        }
+    }
+
+    if (!terminated) {
+        retire();
+        jump(address, "    ");
+        successors.push_back(address);
+    }
+
+    // Only the last instruction transfers control, so the tail is every other
+    // instruction with an exit in front of each, taken once the budget runs out
+    std::string body = out.str();
+    std::ostringstream tail;
+    std::vector<size_t> tailSteps;
+    for (unsigned int i = 0; i + 1 < length; ++i) {
+        tailSteps.push_back(tail.tellp());
+        if (i > 0) {
+            tail << "    if (budget == " << i << ") {\n";
+            tail << "        pc = " << hex(start + 2 * i, 3) << ";\n";
+            tail << "        return 0;\n";
+            tail << "    }\n";
+        }
+        tail << body.substr(steps[i], steps[i + 1] - steps[i]);
+    }
+    if (length > 1) {
+        tail << "    pc = " << hex(start + 2 * (length - 1), 3) << ";\n";
+        tail << "    return 0;\n";
+    }
+
+    std::vector<size_t> bodySteps(steps.begin(), steps.end());
+    return {length, body, tail.str(), bodySteps, tailSteps};
+}
+
+template <typename Quirks>
+std::string generate(Rom const& rom, std::string const& romName, Variant variant)
+{
+    // Discover reachable blocks from the entry point
+    BlockSet compiled;
+    std::vector<unsigned int> worklist{START_ADDRESS};
+    std::set<unsigned int> seen;
+
+    while (!worklist.empty()) {
+        unsigned int start = worklist.back();
+        worklist.pop_back();
+        if (!seen.insert(start).second || !rom.Contains(start)) {
+            continue;
+        }
+
+        std::vector<unsigned int> successors;
+        if (translateBlock<Quirks>(rom, start, successors, nullptr).length > 0) {
+            compiled.insert(start);
+        }
+        worklist.insert(worklist.end(), successors.begin(), successors.end());
+    }
+
+    // Translate again now that every goto target is known
+    std::map<unsigned int, BlockCode> blocks;
+    for (unsigned int start : compiled) {
+        std::vector<unsigned int> successors;
+        blocks.emplace(start, translateBlock<Quirks>(rom, start, successors, &compiled));
+    }
+
+    // The runner may enter at any instruction of a block, because a batch that
+    // ran out of budget inside one resumes there. Each address gets one entry:
+    // a block start, or else the first block that covers it.
+    struct Entry
+    {
+        unsigned int start;     // Block holding the code
+        unsigned int offset;    // Instructions into the block
+        unsigned int length;    // Instructions from the entry to the end of the block
+    };
+    std::map<unsigned int, Entry> entries;
+    for (auto const& [start, code] : blocks) {
+        entries[start] = {start, 0, code.length};
+    }
+    for (auto const& [start, code] : blocks) {
+        for (unsigned int i = 1; i < code.length; ++i) {
+            entries.insert({start + 2 * i, {start, i, code.length - i}});
+        }
+    }
+    std::map<unsigned int, int> entryIndex;
+    for (auto const& [address, entry] : entries) {
+        entryIndex.emplace(address, static_cast<int>(entryIndex.size()));
+    }
+
+    // Block code with a label in front of every instruction that owns an entry
+    auto labelled = [&](unsigned int start, std::string const& text, std::vector<size_t> const& steps, char const* prefix) {
+        std::string result;
+        size_t from = 0;
+        for (unsigned int i = 1; i < steps.size(); ++i) {
+            auto entry = entries.find(start + 2 * i);
+            if (entry->second.start == start) {
+                result += text.substr(from, steps[i] - from);
+                result += prefix + hex(start + 2 * i, 3) + ":\n";
+                from = steps[i];
+            }
+        }
+        return result + text.substr(from);
+    };
+
+    std::ostringstream out;
+    out << "// Generated by chip8_aot from " << quote(romName) << ". Do not edit.\n\n";
+    out << "#include \"StaticRom.hpp\"\n\n";
+    out << "namespace {\n\n";
+
+    out << "const uint8_t image[] = {";
+    for (size_t i = 0; i < rom.image.size(); ++i) {
+        out << (i % 16 == 0 ? "\n    " : " ") << hex(rom.image[i], 2) << ",";
+    }
+    out << "\n};\n\n";
+
+    out << "const StaticRom::Block blocks[] = {\n";
+    for (auto const& [address, entry] : entries) {
+        out << "    {" << hex(address, 3) << ", " << entry.length << "},\n";
+    }
+    out << "};\n\n";
+
+    // Entered where the runner has validated the code; returns the budget left.
+    // Each block's guard sends control back to the runner when the block does
+    // not fit the budget, may have been overwritten, or heads an idle loop.
+    // The runner re-enters a block too long for the budget at its tail, which
+    // ends the batch in compiled code. An entry inside a block counts the
+    // budget from the block's start, as if the instructions before it had run.
+    out << "int64_t Run(Chip8& chip8, StaticCore const& core, int block, int64_t budget)\n{\n";
+    out << "    [[maybe_unused]] uint8_t* V = StaticRom::Registers(chip8);\n";
+    out << "    [[maybe_unused]] uint16_t* stack = StaticRom::Stack(chip8);\n";
+    out << "    [[maybe_unused]] uint16_t& I = StaticRom::Index(chip8);\n";
+    out << "    [[maybe_unused]] uint16_t& pc = StaticRom::Pc(chip8);\n";
+    out << "    [[maybe_unused]] uint8_t& sp = StaticRom::Sp(chip8);\n";
+    out << "    [[maybe_unused]] uint16_t sum;\n\n";
+
+    out << "    switch (block) {\n";
+    for (auto const& [address, entry] : entries) {
+        const unsigned int blockLength = entry.offset + entry.length;
+        out << "        case " << entryIndex[address] << ":\n";
+        if (entry.offset > 0) {
+            out << "            budget += " << entry.offset << ";\n";
+        }
+        if (entry.length > 1) {
+            out << "            if (budget < " << blockLength << ") {\n";
+            out << "                goto Tail_" << hex(address, 3) << ";\n";
+            out << "            }\n";
+        }
+        out << "            goto Enter_" << hex(address, 3) << ";\n";
+    }
+    out << "    }\n";
+    out << "    return budget;\n\n";
+
+    // Only emitted for ROMs that use 00EE or Bnnn
+    bool computed = false;
+    for (auto const& [start, code] : blocks) {
+        computed = computed || code.body.find("goto Dispatch;") != std::string::npos;
+    }
+    if (computed) {
+        out << "Dispatch:\n";
+        out << "    switch (pc) {\n";
+        for (auto const& [start, code] : blocks) {
+            out << "        case " << hex(start, 3) << ": goto Block_" << hex(start, 3) << ";\n";
+        }
+        out << "    }\n";
+        out << "    return budget;\n\n";
+    }
+
+    // Blocks nothing jumps to, such as the entry point, are reached only through the runner
+    std::string all;
+    for (auto const& [start, code] : blocks) {
+        all += code.body;
+    }
+
+    for (auto const& [start, code] : blocks) {
+        if (computed || all.find("goto Block_" + hex(start, 3) + ";") != std::string::npos) {
+            out << "Block_" << hex(start, 3) << ":\n";
+            out << "    if (!core.Chainable(" << entryIndex[start] << ", " << code.length << ", budget)) {\n";
+            out << "        pc = " << hex(start, 3) << ";\n";
+            out << "        return budget;\n";
+            out << "    }\n";
+        }
+        out << "Enter_" << hex(start, 3) << ":\n";
+        out << labelled(start, code.body, code.bodySteps, "Enter_") << "\n";
+        if (code.length > 1) {
+            out << "Tail_" << hex(start, 3) << ":\n";
+            out << labelled(start, code.tail, code.tailSteps, "Tail_") << "\n";
+        }
+    }
+    out << "}\n\n";
+
+    out << "const StaticRom rom(" << quote(romName) << ", Variant::" << VARIANT_NAMES[static_cast<int>(variant)] << ", image, sizeof(image), blocks, sizeof(blocks) / sizeof(blocks[0]), &Run);\n\n";
+    out << "}\n";
+    return out.str();
+}
+
+int main(int argc, char** argv)
+{
+    int argIndex = 1;
+    bool variantGiven = false;
+    Variant variant{};
+
+    if (argc > 1 && std::strncmp(argv[1], QUIRKS_OPTION, sizeof(QUIRKS_OPTION) - 1) == 0)
+    {
+        if (!ParseVariant(argv[1] + sizeof(QUIRKS_OPTION) - 1, variant))
+        {
+            std::cerr << "Unknown quirks: " << argv[1] + sizeof(QUIRKS_OPTION) - 1 << "\n";
+            return EXIT_FAILURE;
+        }
+        variantGiven = true;
+        ++argIndex;
+    }
+
+    if (argc - argIndex + 1 != REQUIRED_ARGS)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--quirks=modern|cosmac|schip|xochip] <ROM> <OUTPUT>\n";
+        return EXIT_FAILURE;
+    }
+
+    char const* romFilename = argv[argIndex];
+    char const* outputFilename = argv[argIndex + 1];
+
+    std::ifstream file(romFilename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Cannot open ROM: " << romFilename << "\n";
+        return EXIT_FAILURE;
+    }
+
+    Rom rom;
+    rom.image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (rom.image.size() > MEMORY_SIZE - START_ADDRESS)
+    {
+        rom.image.resize(MEMORY_SIZE - START_ADDRESS);
+    }
+
+    if (!variantGiven)
+    {
+        variant = Chip8::DetectVariant(romFilename);
+    }
+
+    std::string romName = romFilename;
+    size_t slash = romName.find_last_of("/\\");
+    if (slash != std::string::npos)
+    {
+        romName = romName.substr(slash + 1);
+    }
+
+    std::ofstream output(outputFilename);
+    if (!output.is_open())
+    {
+        std::cerr << "Cannot write: " << outputFilename << "\n";
+        return EXIT_FAILURE;
+    }
+    output << WithQuirks(variant, [&](auto quirks) {
+        return generate<decltype(quirks)>(rom, romName, variant);
+    });
+
+    return 0;
+}
@@ -0,0 +1,408 @@
+#include "Chip8.hpp"
+#include "SpeedController.hpp"
+#include "StaticRom.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Minimum number of command-line arguments: cycle count and at least one ROM
+const int MIN_ARGS = 3;
+
+// Fixed seed so every core sees the same Cxkk sequence
+const unsigned int BENCH_SEED = 0xC8C8;
+
+// Instructions between pseudo-random keypad changes in lockstep and pair-report modes
+const long KEY_CHANGE_INTERVAL = 997;
+
+// Rows printed per table in the pair-frequency report
+const size_t REPORT_ROWS = 12;
+
+enum class Mode
+{
+    Benchmark,
+    Lockstep,
+    Pairs,
+    Speed
+};
+
+struct CoreEntry
+{
+    const char* name;
+    Chip8::Core core;
+};
+
+const CoreEntry CORES[] = {
+    {"interpreter", Chip8::Core::Interpreter},
+    {"threaded", Chip8::Core::Threaded},
+    {"cached", Chip8::Core::Cached},
+    {"jit", Chip8::Core::Jit},
+    {"static", Chip8::Core::Static}
+};
+
+struct BenchResult
+{
+    double instructionsPerSecond;
+    double spriteHitRate;
+};
+
+// Guest frame length set with --ipf; zero keeps the emulator's default
+unsigned int instructionsPerFrame = 0;
+
+void applyFrameLength(Chip8& chip8)
+{
+    if (instructionsPerFrame > 0)
+    {
+        chip8.SetInstructionsPerFrame(instructionsPerFrame);
+    }
+}
+
+// Quirk policy set with --quirks; otherwise each ROM's detected one
+bool variantGiven = false;
+Variant variantOverride{};
+
+Variant romVariant(const char* romFilename)
+{
+    return variantGiven ? variantOverride : Chip8::DetectVariant(romFilename);
+}
+
+// Runs a ROM headless for a fixed number of instructions and reports the throughput
+BenchResult benchmarkRom(const char* romFilename, Chip8::Core core, long cycles, bool spriteCache)
+{
+    Chip8 chip8(BENCH_SEED, romVariant(romFilename));
+    chip8.LoadROM(romFilename);
+    chip8.SetCore(core);
+    chip8.SetSpriteCache(spriteCache);
+    applyFrameLength(chip8);
+
+    const auto startTime = std::chrono::steady_clock::now();
+    chip8.RunCycles(static_cast<unsigned int>(cycles));
+    const auto endTime = std::chrono::steady_clock::now();
+
+    const std::chrono::duration<double> elapsed = endTime - startTime;
+    const uint64_t lookups = chip8.SpriteCacheHits() + chip8.SpriteCacheMisses();
+    const double hitRate = lookups > 0 ? static_cast<double>(chip8.SpriteCacheHits()) / lookups : 0.0;
+    return {cycles / elapsed.count(), hitRate};
+}
+
+// Queues a replay that holds at most one pseudo-random key at a time, changing every KEY_CHANGE_INTERVAL instructions
+void scriptKeypad(Chip8& chip8, long cycles)
+{
+    uint32_t keySeed = 1;
+    for (long i = 0; i < cycles; i += KEY_CHANGE_INTERVAL)
+    {
+        keySeed = keySeed * 1103515245u + 12345u;
+        uint16_t key = (keySeed >> 16) & 0xFu;
+        uint16_t state = (keySeed >> 20) & 0x1u;
+        chip8.QueueInput(static_cast<uint64_t>(i), static_cast<uint16_t>(state << key));
+    }
+}
+
+// Largest batch the lockstep check hands the candidate core; each batch is
+// drawn from [1, n] for one of these n, so both single steps and long runs
+// through fused idioms, compiled blocks and idle-loop skips get exercised
+const unsigned int LOCKSTEP_BATCH_LIMITS[] = {1, 7, 100, 1000};
+
+// Runs a core in pseudo-random batches, half of them stopping on draws, while
+// the reference interpreter single-steps to the same guest cycle; compares the
+// full machine state after every batch and returns the cycle at which the
+// first mismatch was seen, or -1 if none diverged
+long lockstepRom(const char* romFilename, Chip8::Core core, long cycles, bool spriteCache)
+{
+    const Variant variant = romVariant(romFilename);
+    Chip8 reference(BENCH_SEED, variant);
+    Chip8 candidate(BENCH_SEED, variant);
+    reference.LoadROM(romFilename);
+    candidate.LoadROM(romFilename);
+    candidate.SetCore(core);
+    candidate.SetSpriteCache(spriteCache);
+    applyFrameLength(reference);
+    applyFrameLength(candidate);
+    scriptKeypad(reference, cycles);
+    scriptKeypad(candidate, cycles);
+
+    uint32_t batchSeed = BENCH_SEED;
+    const uint64_t end = static_cast<uint64_t>(cycles);
+    while (candidate.InstructionCount() < end)
+    {
+        batchSeed = batchSeed * 1103515245u + 12345u;
+        const unsigned int limit = LOCKSTEP_BATCH_LIMITS[(batchSeed >> 16) % std::size(LOCKSTEP_BATCH_LIMITS)];
+        const uint64_t remaining = end - candidate.InstructionCount();
+        const unsigned int batch = static_cast<unsigned int>(std::min<uint64_t>((batchSeed >> 8) % limit + 1, remaining));
+
+        if (batchSeed & 0x80000000u)
+        {
+            candidate.RunUntil(batch, Chip8::StopOnDraw);
+        }
+        else
+        {
+            candidate.RunCycles(batch);
+        }
+
+        while (reference.InstructionCount() < candidate.InstructionCount())
+        {
+            reference.RunCycles(1);
+        }
+
+        if (!reference.StateEquals(candidate))
+        {
+            return static_cast<long>(reference.InstructionCount());
+        }
+    }
+    return -1;
+}
+
+// Host cost of each frame in the speed check, in frame intervals: the emulation
+// thread's run and its presentation work, and the render thread's presentation.
+// Presentation is only charged to presented frames. Each shape keeps one thread
+// overloaded; only an overloaded emulation thread may slow the guest. Packing
+// overloads it with no run time at all, the edge of the controller's arithmetic.
+struct Overload
+{
+    const char* name;
+    double emulate;
+    double present;
+    double render;
+    bool slowsGuest;
+};
+
+const Overload SPEED_OVERLOADS[] = {
+    {"emulation", 2.0, 0.1, 0.1, true},
+    {"presentation", 0.05, 0.02, 4.0, false},
+    {"packing", 0.0, 4.0, 0.1, true},
+};
+
+struct SpeedCheck
+{
+    long failedFrame;               // -1 if the controller held the range and settled where expected
+    unsigned int instructionsPerFrame;
+    unsigned int expectedInstructionsPerFrame;
+};
+
+// Holds a SpeedController for the ROM's default profile under constant overload.
+// The instructions per frame must stay inside the profile's range every frame.
+// When the emulation thread is the bottleneck they must have come down to the
+// minimum by the end; when only the render thread is, they must stay at the
+// target throughout while fewer frames are presented.
+SpeedCheck speedCheckRom(const char* romFilename, Overload const& overload, long frames)
+{
+    const SpeedProfile profile = DefaultSpeedProfile(romVariant(romFilename));
+    const int64_t frameIntervalNs = 1000000000 / SPEED_FRAMES_PER_SECOND;
+    SpeedController controller(profile, frameIntervalNs);
+    const unsigned int expected = overload.slowsGuest ? profile.minInstructionsPerFrame : controller.InstructionsPerFrame();
+
+    for (long frame = 0; frame < frames; ++frame)
+    {
+        const bool present = controller.ShouldPresent(frame);
+        controller.EndFrame(static_cast<int64_t>(overload.emulate * frameIntervalNs),
+                            present ? static_cast<int64_t>(overload.present * frameIntervalNs) : 0,
+                            present ? static_cast<int64_t>(overload.render * frameIntervalNs) : 0);
+
+        const unsigned int instructions = controller.InstructionsPerFrame();
+        if (instructions < profile.minInstructionsPerFrame || instructions > profile.maxInstructionsPerFrame
+            || (!overload.slowsGuest && instructions != expected))
+        {
+            return {frame, instructions, expected};
+        }
+    }
+    const unsigned int settled = controller.InstructionsPerFrame();
+    const bool settledAsExpected = settled == expected && (overload.slowsGuest || controller.Metrics().presentInterval > 1);
+    return {settledAsExpected ? -1 : frames, settled, expected};
+}
+
+void printTopSequences(const char* title, std::map<std::string, long> const& counts, long total)
+{
+    std::vector<std::pair<std::string, long>> sorted(counts.begin(), counts.end());
+    std::sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) { return a.second > b.second; });
+
+    std::cout << "  " << title << ":\n";
+    for (size_t i = 0; i < sorted.size() && i < REPORT_ROWS; ++i)
+    {
+        std::cout << "    " << std::left << std::setw(16) << sorted[i].first << std::right << std::setw(12) << sorted[i].second
+                  << std::fixed << std::setprecision(2) << std::setw(8) << 100.0 * sorted[i].second / total << "%\n";
+    }
+}
+
+// Runs a ROM on the interpreter and prints its most frequent dynamic opcode pairs
+// and triples, the candidates for superinstruction fusion
+void pairsRom(const char* romFilename, long cycles)
+{
+    Chip8 chip8(BENCH_SEED, romVariant(romFilename));
+    chip8.LoadROM(romFilename);
+    applyFrameLength(chip8);
+    scriptKeypad(chip8, cycles);
+
+    std::map<std::string, long> pairs;
+    std::map<std::string, long> triples;
+    std::string previous;
+    std::string beforePrevious;
+
+    for (long i = 0; i < cycles; ++i)
+    {
+        std::string current = Chip8::OpcodeName(chip8.NextOpcode());
+        if (!previous.empty())
+        {
+            ++pairs[previous + " " + current];
+        }
+        if (!beforePrevious.empty())
+        {
+            ++triples[beforePrevious + " " + previous + " " + current];
+        }
+        beforePrevious = previous;
+        previous = current;
+
+        chip8.RunCycles(1);
+    }
+
+    std::cout << romFilename << ":\n";
+    printTopSequences("pairs", pairs, cycles);
+    printTopSequences("triples", triples, cycles);
+}
+
+int main(int argc, char** argv)
+{
+    int argIndex = 1;
+    Mode mode = Mode::Benchmark;
+
+    if (argc > 1 && std::strcmp(argv[1], "--lockstep") == 0)
+    {
+        mode = Mode::Lockstep;
+        ++argIndex;
+    }
+    else if (argc > 1 && std::strcmp(argv[1], "--pairs") == 0)
+    {
+        mode = Mode::Pairs;
+        ++argIndex;
+    }
+    else if (argc > 1 && std::strcmp(argv[1], "--speed") == 0)
+    {
+        mode = Mode::Speed;
+        ++argIndex;
+    }
+
+    bool spriteCache = false;
+    if (argIndex < argc && std::strcmp(argv[argIndex], "--sprite-cache") == 0)
+    {
+        spriteCache = true;
+        ++argIndex;
+    }
+
+    if (argIndex < argc && std::strncmp(argv[argIndex], "--ipf=", 6) == 0)
+    {
+        instructionsPerFrame = static_cast<unsigned int>(std::strtoul(argv[argIndex] + 6, nullptr, 10));
+        ++argIndex;
+    }
+
+    if (argIndex < argc && std::strncmp(argv[argIndex], "--quirks=", 9) == 0)
+    {
+        if (!ParseVariant(argv[argIndex] + 9, variantOverride))
+        {
+            std::cerr << "Unknown quirks: " << argv[argIndex] + 9 << "\n";
+            return EXIT_FAILURE;
+        }
+        variantGiven = true;
+        ++argIndex;
+    }
+
+    if (argc - argIndex + 1 < MIN_ARGS)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--lockstep|--pairs|--speed] [--sprite-cache] [--ipf=N] [--quirks=modern|cosmac|schip|xochip] <Cycles> <ROM>...\n";
+        return EXIT_FAILURE;
+    }
+
+    long cycles{};
+
+    try
+    {
+        cycles = std::stol(argv[argIndex]);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << "Invalid arguments: Cycles must be an integer.\n";
+        return EXIT_FAILURE;
+    }
+    catch (const std::out_of_range& e)
+    {
+        std::cerr << "Arguments out of range.\n";
+        return EXIT_FAILURE;
+    }
+
+    int result = 0;
+
+    for (int i = argIndex + 1; i < argc; ++i)
+    {
+        if (mode == Mode::Pairs)
+        {
+            pairsRom(argv[i], cycles);
+            continue;
+        }
+
+        if (mode == Mode::Speed)
+        {
+            for (const Overload& overload : SPEED_OVERLOADS)
+            {
+                const SpeedCheck check = speedCheckRom(argv[i], overload, cycles);
+                if (check.failedFrame >= 0)
+                {
+                    std::cout << argv[i] << " [" << overload.name << " overload]: " << check.instructionsPerFrame
+                              << " instructions per frame at frame " << check.failedFrame
+                              << ", expected " << check.expectedInstructionsPerFrame << "\n";
+                    result = EXIT_FAILURE;
+                }
+                else
+                {
+                    std::cout << argv[i] << " [" << overload.name << " overload]: ok\n";
+                }
+            }
+            continue;
+        }
+
+        for (const CoreEntry& entry : CORES)
+        {
+            // The static core only exists in the ROM-specific chip8_bench_<ROM> builds
+            if (entry.core == Chip8::Core::Static && StaticRom::Linked() == nullptr)
+            {
+                continue;
+            }
+
+            if (mode == Mode::Lockstep)
+            {
+                if (entry.core == Chip8::Core::Interpreter)
+                {
+                    continue;
+                }
+
+                const long divergence = lockstepRom(argv[i], entry.core, cycles, spriteCache);
+                if (divergence >= 0)
+                {
+                    std::cout << argv[i] << " [" << entry.name << "]: diverged by cycle " << divergence << "\n";
+                    result = EXIT_FAILURE;
+                }
+                else
+                {
+                    std::cout << argv[i] << " [" << entry.name << "]: ok\n";
+                }
+            }
+            else
+            {
+                const BenchResult bench = benchmarkRom(argv[i], entry.core, cycles, spriteCache);
+                std::cout << argv[i] << " [" << entry.name << "]: " << static_cast<long>(bench.instructionsPerSecond) << " instructions/sec";
+                if (spriteCache)
+                {
+                    std::cout << ", sprite cache " << std::fixed << std::setprecision(1) << 100.0 * bench.spriteHitRate << "% hits";
+                }
+                std::cout << "\n";
+            }
+        }
+    }
+
+    return result;
+}
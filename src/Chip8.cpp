@@ -1,16 +1,49 @@
 // Chip8.cpp
 
 #include "Chip8.hpp"
+#include "Jit.hpp"
+#include "StaticRom.hpp"
 #include <memory>
 #include <chrono>
 #include <cstring>
 #include <fstream>
+#include <iterator>
+#include <algorithm>
 #include <random>
-#include <map>
+#include <vector>
 
 const unsigned int FONTSET_SIZE = 80;
-const unsigned int FONTSET_START_ADDRESS = 0x50;
-const unsigned int START_ADDRESS = 0x200;
+
+// Longest superinstruction, and the guest instructions each Fusion covers
+const unsigned int MAX_FUSED_LENGTH = 3;
+const unsigned int FUSED_LENGTH[] = {1, 3, 3, 3, 2, 1, 1};
+
+// Sprite rows are placed with 64-bit shifts
+static_assert(VIDEO_WIDTH == 64, "one framebuffer row per uint64_t");
+static_assert(VIDEO_HEIGHT == 32, "one dirty-row bit per row in a uint32_t");
+
+// Multiply-xorshift mixing for VideoHash(), one independent lane per row modulo 4
+const unsigned int HASH_LANES = 4;
+const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+const uint64_t HASH_SEEDS[HASH_LANES] = {
+    0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull
+};
+static_assert(VIDEO_HEIGHT % HASH_LANES == 0, "whole rows per lane");
+
+// Frame length until SetInstructionsPerFrame() is called
+const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 10;
+
+// Sprite cache key; height is never zero, so neither is the key
+static uint32_t SpriteKey(uint16_t address, uint8_t height, uint8_t shift)
+{
+    return address | (height << 12u) | (shift << 16u);
+}
+
+// Wrapping sprite placement
+static uint64_t RotateRight(uint64_t value, unsigned int shift)
+{
+    return (value >> shift) | (value << ((64 - shift) & 63));
+}
 
 uint8_t fontset[FONTSET_SIZE] =
     {
@@ -32,10 +65,17 @@ uint8_t fontset[FONTSET_SIZE] =
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
 
-Chip8::Chip8()
-    : randGen(std::chrono::system_clock::now().time_since_epoch().count())
+Chip8::Chip8(Variant variant)
+    : Chip8(static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count()), variant)
+{
+}
+
+Chip8::Chip8(unsigned int seed, Variant variant)
+    : variant(variant), instructionsPerFrame(DEFAULT_INSTRUCTIONS_PER_FRAME), randGen(seed)
 {
     pc = START_ADDRESS;
+    scheduler.Schedule(Scheduler::TimerTick, instructionsPerFrame);
+    scheduler.Schedule(Scheduler::VBlank, instructionsPerFrame);
 
     for (unsigned int i = 0; i < FONTSET_SIZE; ++i)
     {
@@ -44,43 +84,108 @@ Chip8::Chip8()
 
     randByte = std::uniform_int_distribution<uint8_t>(0, 255U);
 
-    // Initialize the opcode map with all opcodes and their corresponding functions
-    opcodeMap = {
-        {0x00E0, &Chip8::OP_00E0},
-        {0x00EE, &Chip8::OP_00EE},
-        {0x1000, &Chip8::OP_1nnn},
-        {0x2000, &Chip8::OP_2nnn},
-        {0x3000, &Chip8::OP_3xkk},
-        {0x4000, &Chip8::OP_4xkk},
-        {0x5000, &Chip8::OP_5xy0},
-        {0x6000, &Chip8::OP_6xkk},
-        {0x7000, &Chip8::OP_7xkk},
-        {0x8000, &Chip8::OP_8xy0},
-        {0x8001, &Chip8::OP_8xy1},
-        {0x8002, &Chip8::OP_8xy2},
-        {0x8003, &Chip8::OP_8xy3},
-        {0x8004, &Chip8::OP_8xy4},
-        {0x8005, &Chip8::OP_8xy5},
-        {0x8006, &Chip8::OP_8xy6},
-        {0x8007, &Chip8::OP_8xy7},
-        {0x800E, &Chip8::OP_8xyE},
-        {0x9000, &Chip8::OP_9xy0},
-        {0xA000, &Chip8::OP_Annn},
-        {0xB000, &Chip8::OP_Bnnn},
-        {0xC000, &Chip8::OP_Cxkk},
-        {0xD000, &Chip8::OP_Dxyn},
-        {0xE09E, &Chip8::OP_Ex9E},
-        {0xE0A1, &Chip8::OP_ExA1},
-        {0xF007, &Chip8::OP_Fx07},
-        {0xF00A, &Chip8::OP_Fx0A},
-        {0xF015, &Chip8::OP_Fx15},
-        {0xF018, &Chip8::OP_Fx18},
-        {0xF01E, &Chip8::OP_Fx1E},
-        {0xF029, &Chip8::OP_Fx29},
-        {0xF033, &Chip8::OP_Fx33},
-        {0xF055, &Chip8::OP_Fx55},
-        {0xF065, &Chip8::OP_Fx65}
+    decodeTable = DecodeTable(variant);
+}
+
+Chip8::~Chip8() = default;
+
+template <typename Quirks>
+Chip8::Instruction Chip8::Decode(uint16_t opcode) {
+    // Indexed by OpId
+    static OpcodeFunc const handlers[] = {
+        &Chip8::OP_NULL, &Chip8::OP_00E0, &Chip8::OP_00EE, &Chip8::OP_1nnn, &Chip8::OP_2nnn,
+        &Chip8::OP_3xkk, &Chip8::OP_4xkk, &Chip8::OP_5xy0, &Chip8::OP_6xkk, &Chip8::OP_7xkk,
+        &Chip8::OP_8xy0, &Chip8::OP_8xy1, &Chip8::OP_8xy2, &Chip8::OP_8xy3, &Chip8::OP_8xy4,
+        &Chip8::OP_8xy5, &Chip8::OP_8xy6<Quirks>, &Chip8::OP_8xy7, &Chip8::OP_8xyE<Quirks>, &Chip8::OP_9xy0,
+        &Chip8::OP_Annn, &Chip8::OP_Bnnn<Quirks>, &Chip8::OP_Cxkk, &Chip8::OP_Dxyn<Quirks>, &Chip8::OP_Ex9E,
+        &Chip8::OP_ExA1, &Chip8::OP_Fx07, &Chip8::OP_Fx0A, &Chip8::OP_Fx15, &Chip8::OP_Fx18,
+        &Chip8::OP_Fx1E, &Chip8::OP_Fx29, &Chip8::OP_Fx33, &Chip8::OP_Fx55<Quirks>, &Chip8::OP_Fx65<Quirks>
     };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<size_t>(OpId::Count),
+                  "handler table out of sync with OpId");
+
+    Instruction in{};
+    in.nnn = opcode & 0x0FFFu;
+    in.x = (opcode & 0x0F00u) >> 8u;
+    in.y = (opcode & 0x00F0u) >> 4u;
+    in.n = opcode & 0x000Fu;
+    in.kk = opcode & 0x00FFu;
+
+    switch (opcode & 0xF000u) {
+        case 0x0000:
+            if (opcode == 0x00E0) in.op = OpId::OP_00E0;
+            else if (opcode == 0x00EE) in.op = OpId::OP_00EE;
+            else in.op = OpId::OP_NULL;
+            break;
+        case 0x1000: in.op = OpId::OP_1nnn; break;
+        case 0x2000: in.op = OpId::OP_2nnn; break;
+        case 0x3000: in.op = OpId::OP_3xkk; break;
+        case 0x4000: in.op = OpId::OP_4xkk; break;
+        case 0x5000: in.op = OpId::OP_5xy0; break;
+        case 0x6000: in.op = OpId::OP_6xkk; break;
+        case 0x7000: in.op = OpId::OP_7xkk; break;
+        case 0x8000:
+            switch (in.n) {
+                case 0x0: in.op = OpId::OP_8xy0; break;
+                case 0x1: in.op = OpId::OP_8xy1; break;
+                case 0x2: in.op = OpId::OP_8xy2; break;
+                case 0x3: in.op = OpId::OP_8xy3; break;
+                case 0x4: in.op = OpId::OP_8xy4; break;
+                case 0x5: in.op = OpId::OP_8xy5; break;
+                case 0x6: in.op = OpId::OP_8xy6; break;
+                case 0x7: in.op = OpId::OP_8xy7; break;
+                case 0xE: in.op = OpId::OP_8xyE; break;
+                default: in.op = OpId::OP_NULL; break;
+            }
+            break;
+        case 0x9000: in.op = OpId::OP_9xy0; break;
+        case 0xA000: in.op = OpId::OP_Annn; break;
+        case 0xB000: in.op = OpId::OP_Bnnn; break;
+        case 0xC000: in.op = OpId::OP_Cxkk; break;
+        case 0xD000: in.op = OpId::OP_Dxyn; break;
+        case 0xE000:
+            switch (in.kk) {
+                case 0x9E: in.op = OpId::OP_Ex9E; break;
+                case 0xA1: in.op = OpId::OP_ExA1; break;
+                default: in.op = OpId::OP_NULL; break;
+            }
+            break;
+        case 0xF000:
+            switch (in.kk) {
+                case 0x07: in.op = OpId::OP_Fx07; break;
+                case 0x0A: in.op = OpId::OP_Fx0A; break;
+                case 0x15: in.op = OpId::OP_Fx15; break;
+                case 0x18: in.op = OpId::OP_Fx18; break;
+                case 0x1E: in.op = OpId::OP_Fx1E; break;
+                case 0x29: in.op = OpId::OP_Fx29; break;
+                case 0x33: in.op = OpId::OP_Fx33; break;
+                case 0x55: in.op = OpId::OP_Fx55; break;
+                case 0x65: in.op = OpId::OP_Fx65; break;
+                default: in.op = OpId::OP_NULL; break;
+            }
+            break;
+    }
+    in.handler = handlers[static_cast<uint8_t>(in.op)];
+    return in;
+}
+
+template <typename Quirks>
+Chip8::Instruction const* Chip8::DecodeTable() {
+    // Built once per process on first use; every opcode value maps straight to its handler
+    static std::vector<Instruction> const table = [] {
+        std::vector<Instruction> entries(0x10000);
+        for (uint32_t opcode = 0; opcode <= 0xFFFF; ++opcode) {
+            entries[opcode] = Decode<Quirks>(static_cast<uint16_t>(opcode));
+        }
+        return entries;
+    }();
+    return table.data();
+}
+
+Chip8::Instruction const* Chip8::DecodeTable(Variant variant) {
+    return WithQuirks(variant, [](auto quirks) {
+        return DecodeTable<decltype(quirks)>();
+    });
 }
 
 void Chip8::LoadROM(const char* filename) {
@@ -93,74 +198,326 @@ void Chip8::LoadROM(const char* filename) {
         file.read(buffer.get(), size);
         file.close();
 
-        for (long i = 0; i < size; ++i) {
+        for (long i = 0; i < size && START_ADDRESS + i < MEMORY_SIZE; ++i) {
             memory[START_ADDRESS + i] = buffer[i];
         }
+
+        std::fill(std::begin(icache), std::end(icache), Instruction{});
+        FlushSpriteCache();
+        if (jit) {
+            jit->Flush();
+        }
+        if (staticCore) {
+            staticCore->Reset();
+        }
     }
 }
 
-void Chip8::Cycle() {
-    opcode = (memory[pc] << 8u) | memory[pc + 1];
-    pc += 2;
+Variant Chip8::DetectVariant(char const* filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<uint8_t> rom{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
 
-    uint16_t lookup_key = opcode & 0xF000;
+    // Walk the code reachable from the entry point so sprite data is never mistaken for opcodes
+    // XO-CHIP ROMs may be longer than the 3584 bytes above START_ADDRESS; only
+    // the part that fits in memory is walked, and targets beyond it are dropped
+    std::vector<bool> seen(MEMORY_SIZE);
+    std::vector<uint16_t> worklist{START_ADDRESS};
+    auto follow = [&worklist](unsigned int target) {
+        if (target < MEMORY_SIZE) {
+            worklist.push_back(static_cast<uint16_t>(target));
+        }
+    };
 
-    switch (lookup_key) {
-        case 0x0000:
-        {
-            switch (opcode) {
-                case 0x00E0:
-                    (this->*opcodeMap[0x00E0])();
+    while (!worklist.empty()) {
+        uint16_t address = worklist.back();
+        worklist.pop_back();
+
+        while (address >= START_ADDRESS && address < MEMORY_SIZE - 1 && address - START_ADDRESS + 1 < rom.size() && !seen[address]) {
+            seen[address] = true;
+            uint16_t opcode = (rom[address - START_ADDRESS] << 8u) | rom[address - START_ADDRESS + 1];
+            uint16_t nnn = opcode & 0x0FFFu;
+            uint16_t kk = opcode & 0x00FFu;
+
+            // Opcodes that only exist on the extended interpreters
+            if (opcode == 0xF000 || (opcode & 0xFFF0u) == 0x00D0 || (opcode & 0xF00Eu) == 0x5002 || (opcode & 0xF0FFu) == 0xF03A) {
+                return Variant::XoChip;
+            }
+            if ((opcode & 0xFFF0u) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF)
+                || ((opcode & 0xF000u) == 0xF000 && (kk == 0x30 || kk == 0x75 || kk == 0x85))) {
+                return Variant::SuperChip;
+            }
+
+            switch (opcode & 0xF000u) {
+                case 0x1000:
+                    address = nnn;
+                    continue;
+                case 0x2000:
+                    follow(nnn);
                     break;
-                case 0x00EE:
-                    (this->*opcodeMap[0x00EE])();
+                case 0x3000: case 0x4000: case 0x5000: case 0x9000: case 0xE000:
+                    follow(address + 4u);
                     break;
+                case 0xB000:
+                    address = 0;
+                    continue;
                 default:
-                    // Handle a custom 0nnn opcode if needed
+                    if (opcode == 0x00EE) {
+                        address = 0;
+                        continue;
+                    }
                     break;
             }
-        } break;
-        case 0x1000: (this->*opcodeMap[0x1000])(); break;
-        case 0x2000: (this->*opcodeMap[0x2000])(); break;
-        case 0x3000: (this->*opcodeMap[0x3000])(); break;
-        case 0x4000: (this->*opcodeMap[0x4000])(); break;
-        case 0x5000: (this->*opcodeMap[0x5000])(); break;
-        case 0x6000: (this->*opcodeMap[0x6000])(); break;
-        case 0x7000: (this->*opcodeMap[0x7000])(); break;
-        case 0x8000:
-        {
-            uint16_t sub_key = opcode & 0x000F;
-            auto it = opcodeMap.find(0x8000 | sub_key);
-            if (it != opcodeMap.end()) {
-                (this->*(it->second))();
+            address += 2;
+        }
+    }
+
+    return Variant::Modern;
+}
+
+unsigned int Chip8::RunCached(unsigned int count) {
+    unsigned int const budget = count;
+    count -= WaitForKey(count);
+
+    while (count > 0 && !stopRequested) {
+        uint16_t address = pc & ADDRESS_MASK;
+        Instruction& in = icache[address];
+        if (in.handler == nullptr) {
+            uint16_t opcode = (memory[address] << 8u) | memory[(address + 1) & ADDRESS_MASK];
+            in = decodeTable[opcode];
+            in.fusion = MatchFusion(address);
+        }
+
+        if (in.fusion != Fusion::None && FUSED_LENGTH[static_cast<uint8_t>(in.fusion)] <= count) {
+            unsigned int executed = RunFused(in, count);
+            if (executed > 0) {
+                count -= executed;
+                continue;
             }
-        } break;
-        case 0x9000: (this->*opcodeMap[0x9000])(); break;
-        case 0xA000: (this->*opcodeMap[0xA000])(); break;
-        case 0xB000: (this->*opcodeMap[0xB000])(); break;
-        case 0xC000: (this->*opcodeMap[0xC000])(); break;
-        case 0xD000: (this->*opcodeMap[0xD000])(); break;
-        case 0xE000:
-        {
-            uint16_t sub_key = opcode & 0x00FF;
-            auto it = opcodeMap.find(0xE000 | sub_key);
-            if (it != opcodeMap.end()) {
-                (this->*(it->second))();
+        }
+
+        pc += 2;
+        (this->*in.handler)(in);
+        --count;
+    }
+    return budget - count;
+}
+
+char const* Chip8::OpcodeName(uint16_t opcode) {
+    // Indexed by OpId
+    static char const* const names[] = {
+        "NULL", "00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+        "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE", "9xy0",
+        "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1", "Fx07", "Fx0A", "Fx15", "Fx18",
+        "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(OpId::Count),
+                  "name table out of sync with OpId");
+
+    return names[static_cast<uint8_t>(DecodeTable(Variant::Modern)[opcode].op)];
+}
+
+void Chip8::PackVideo(uint8_t* bytes) const {
+    for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y) {
+        for (unsigned int b = 0; b < VIDEO_WIDTH / 8; ++b) {
+            *bytes++ = static_cast<uint8_t>(video[y] >> (VIDEO_WIDTH - 8 - 8 * b));
+        }
+    }
+}
+
+uint32_t Chip8::TakeDirtyRows() {
+    uint32_t rows = dirtyRows;
+    dirtyRows = 0;
+    return rows;
+}
+
+uint64_t Chip8::VideoHash() const {
+    // The lanes carry no dependency on each other, so they can be mixed in
+    // parallel (vectorized where the target has 64-bit multiplies)
+    uint64_t lanes[HASH_LANES];
+    std::copy(std::begin(HASH_SEEDS), std::end(HASH_SEEDS), lanes);
+    for (unsigned int y = 0; y < VIDEO_HEIGHT; y += HASH_LANES) {
+        for (unsigned int lane = 0; lane < HASH_LANES; ++lane) {
+            uint64_t h = (lanes[lane] ^ video[y + lane]) * HASH_MULTIPLIER;
+            lanes[lane] = h ^ (h >> 29);
+        }
+    }
+
+    uint64_t hash = 0;
+    for (unsigned int lane = 0; lane < HASH_LANES; ++lane) {
+        hash = (hash ^ lanes[lane]) * HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+uint16_t Chip8::NextOpcode() const {
+    return (memory[pc & ADDRESS_MASK] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
+}
+
+Chip8::Fusion Chip8::MatchFusion(uint16_t address) const {
+    uint16_t opcodes[MAX_FUSED_LENGTH];
+    for (unsigned int i = 0; i < MAX_FUSED_LENGTH; ++i) {
+        uint16_t at = (address + 2 * i) & ADDRESS_MASK;
+        opcodes[i] = (memory[at] << 8u) | memory[(at + 1) & ADDRESS_MASK];
+    }
+
+    if (IdleLoopLength(address) > 0) {
+        return Fusion::IdleLoop;
+    }
+    if ((opcodes[0] & 0xF0FFu) == 0xF00Au) {
+        return Fusion::KeyWait;
+    }
+
+    Instruction const& first = decodeTable[opcodes[0]];
+    Instruction const& second = decodeTable[opcodes[1]];
+    Instruction const& third = decodeTable[opcodes[2]];
+
+    switch (first.op) {
+        case OpId::OP_Fx07:
+            if (second.op == OpId::OP_3xkk && second.x == first.x && third.op == OpId::OP_1nnn) {
+                return Fusion::DelaySpin;
+            }
+            break;
+        case OpId::OP_7xkk:
+            if (second.op == OpId::OP_3xkk && second.x == first.x && third.op == OpId::OP_1nnn) {
+                return Fusion::CountedLoop;
+            }
+            break;
+        case OpId::OP_6xkk:
+            if (second.op == OpId::OP_6xkk && third.op == OpId::OP_Dxyn) {
+                return Fusion::LoadLoadDraw;
+            }
+            break;
+        case OpId::OP_Annn:
+            if (second.op == OpId::OP_Dxyn) {
+                return Fusion::IndexDraw;
+            }
+            break;
+        default:
+            break;
+    }
+    return Fusion::None;
+}
+
+unsigned int Chip8::RunFused(Instruction const& in, unsigned int budget) {
+    unsigned int executed = 0;
+
+    // Byte i of the fused sequence, counted from its first opcode
+    auto byte = [this](unsigned int i) {
+        return memory[(pc + i) & ADDRESS_MASK];
+    };
+
+    switch (in.fusion) {
+        case Fusion::DelaySpin:
+        case Fusion::CountedLoop:
+            if (in.fusion == Fusion::DelaySpin) {
+                registers[in.x] = delayTimer;
+            } else {
+                registers[in.x] += in.kk;
+            }
+            // 3xkk at +2 skips the 1nnn at +4 when the register reaches kk
+            if (registers[in.x] == byte(3)) {
+                pc += 6;
+                executed = 2;
+            } else {
+                pc = ((byte(4) & 0x0Fu) << 8u) | byte(5);
+                executed = 3;
             }
+            break;
+        case Fusion::LoadLoadDraw:
+        {
+            Instruction const& draw = decodeTable[(byte(4) << 8u) | byte(5)];
+            registers[in.x] = in.kk;
+            registers[byte(2) & 0x0Fu] = byte(3);
+            pc += 6;
+            (this->*draw.handler)(draw);
+            executed = 3;
         } break;
-        case 0xF000:
+        case Fusion::IndexDraw:
         {
-            uint16_t sub_key = opcode & 0x00FF;
-            auto it = opcodeMap.find(0xF000 | sub_key);
-            if (it != opcodeMap.end()) {
-                (this->*(it->second))();
-            }
+            Instruction const& draw = decodeTable[(byte(2) << 8u) | byte(3)];
+            index = in.nnn;
+            pc += 4;
+            (this->*draw.handler)(draw);
+            executed = 2;
         } break;
-        default:
-            // Handle unknown opcode or error
+        case Fusion::IdleLoop:
+            return SkipIdleLoop(budget);
+        case Fusion::KeyWait:
+            pc += 2;
+            OP_Fx0A(in);
+            return 1 + WaitForKey(budget - 1);
+        case Fusion::None:
             break;
     }
 
+    return executed;
+}
+
+unsigned int Chip8::IdleLoopLength(uint16_t head) const {
+    // Never follow a loop across the end of memory
+    if (head + 6u > MEMORY_SIZE) {
+        return 0;
+    }
+
+    uint16_t first = (memory[head] << 8u) | memory[head + 1];
+    uint16_t second = (memory[head + 2] << 8u) | memory[head + 3];
+    uint16_t third = (memory[head + 4] << 8u) | memory[head + 5];
+
+    if (first == (0x1000u | head)) {
+        return 1;
+    }
+    if ((first & 0xF0FFu) == 0xF007 && (second & 0xFF00u) == (0x3000u | (first & 0x0F00u)) && third == (0x1000u | head)) {
+        return 3;
+    }
+    return 0;
+}
+
+unsigned int Chip8::SkipIdleLoop(unsigned int budget) {
+    unsigned int length = IdleLoopLength(pc);
+    if (length == 0 || budget < length) {
+        return 0;
+    }
+
+    // The timers only tick between the slices RunUntil() hands out, so within one a delay-timer
+    // poll either exits on its first pass or never does
+    if (length == 3) {
+        uint8_t x = memory[pc] & 0x0Fu;
+        uint8_t kk = memory[pc + 3];
+        if (delayTimer == kk) {
+            return 0;
+        }
+        registers[x] = delayTimer;
+    }
+    return budget / length * length;
+}
+
+bool Chip8::WaitingForKey() const {
+    return waitingForKey;
+}
+
+unsigned int Chip8::WaitForKey(unsigned int budget) {
+    if (!waitingForKey || budget == 0) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < KEY_COUNT; ++i) {
+        if (keypad[i]) {
+            registers[keyRegister] = i;
+            waitingForKey = false;
+            return 1;
+        }
+    }
+
+    // The keypad cannot change until the host runs again
+    if (stopMask & StopOnKeyWait) {
+        RequestStop(StopOnKeyWait, StopReason::KeyWait);
+        return 0;
+    }
+    return budget;
+}
+
+void Chip8::TickTimers() {
     if (delayTimer > 0) {
         --delayTimer;
     }
@@ -169,244 +526,503 @@ void Chip8::Cycle() {
     }
 }
 
-// All opcode function definitions below. These are the same as your original code.
-void Chip8::OP_NULL() {}
+template <typename Quirks>
+uint64_t const* Chip8::ShiftedSprite(uint16_t address, uint8_t height, uint8_t shift) {
+    uint32_t key = SpriteKey(address, height, shift);
+    SpriteCacheEntry& entry = spriteCache[(address ^ (shift << 3)) % SPRITE_CACHE_SIZE];
+    if (entry.key == key) {
+        ++spriteCacheHits;
+        return entry.rows;
+    }
+
+    ++spriteCacheMisses;
+    entry.key = key;
+    for (unsigned int row = 0; row < height; ++row) {
+        uint64_t spriteRow = static_cast<uint64_t>(memory[(address + row) & ADDRESS_MASK]) << (VIDEO_WIDTH - 8);
+        entry.rows[row] = Quirks::wrapSprites ? RotateRight(spriteRow, shift) : spriteRow >> shift;
+    }
+    return entry.rows;
+}
+
+void Chip8::InvalidateSprites(uint16_t address) {
+    for (SpriteCacheEntry& entry : spriteCache) {
+        uint16_t start = entry.key & ADDRESS_MASK;
+        uint8_t height = (entry.key >> 12) & 0xFu;
+        if (static_cast<uint16_t>((address - start) & ADDRESS_MASK) < height) {
+            entry.key = 0;
+        }
+    }
+}
+
+void Chip8::FlushSpriteCache() {
+    for (SpriteCacheEntry& entry : spriteCache) {
+        entry.key = 0;
+    }
+}
+
+void Chip8::SetSpriteCache(bool enabled) {
+    spriteCacheEnabled = enabled;
+    FlushSpriteCache();
+}
+
+uint64_t Chip8::SpriteCacheHits() const {
+    return spriteCacheHits;
+}
+
+uint64_t Chip8::SpriteCacheMisses() const {
+    return spriteCacheMisses;
+}
+
+void Chip8::InvalidateCode(uint16_t address) {
+    // A byte belongs to the instruction starting at it, to the one starting just
+    // before it, and to any superinstruction that starts up to two instructions earlier
+    for (unsigned int i = 0; i < 2 * MAX_FUSED_LENGTH; ++i) {
+        icache[(address - i) & ADDRESS_MASK].handler = nullptr;
+    }
+    if (jit) {
+        jit->Invalidate(address);
+    }
+    if (staticCore) {
+        staticCore->Invalidate(address);
+    }
+    if (spriteCacheEnabled) {
+        InvalidateSprites(address);
+    }
+}
+
+bool Chip8::StateEquals(Chip8 const& other) const {
+    return memcmp(memory, other.memory, sizeof(memory)) == 0
+        && memcmp(registers, other.registers, sizeof(registers)) == 0
+        && memcmp(stack, other.stack, sizeof(stack)) == 0
+        && memcmp(video, other.video, sizeof(video)) == 0
+        && index == other.index
+        && pc == other.pc
+        && sp == other.sp
+        && delayTimer == other.delayTimer
+        && soundTimer == other.soundTimer
+        && waitingForKey == other.waitingForKey
+        && (!waitingForKey || keyRegister == other.keyRegister);
+}
+
+void Chip8::SetCore(Core core) {
+    this->core = core;
+}
+
+void Chip8::SetInstructionsPerFrame(unsigned int count) {
+    // Keep the current frame's start; a frame already longer than the new length ends after the next instruction
+    count = std::max(count, 1u);
+    for (Scheduler::Event event : {Scheduler::TimerTick, Scheduler::VBlank}) {
+        scheduler.Schedule(event, std::max(scheduler.When(event) - instructionsPerFrame + count, instructionCount + 1));
+    }
+    instructionsPerFrame = count;
+}
+
+unsigned int Chip8::InstructionsPerFrame() const {
+    return instructionsPerFrame;
+}
+
+void Chip8::SetBreakpoint(uint16_t address, bool enabled) {
+    bool& slot = breakpoints[address & ADDRESS_MASK];
+    if (slot != enabled) {
+        slot = enabled;
+        breakpointCount += enabled ? 1 : -1;
+    }
+}
+
+void Chip8::SetCycleBreakpoint(uint64_t cycle) {
+    scheduler.Schedule(Scheduler::Breakpoint, cycle);
+}
+
+void Chip8::SetSnapshotInterval(uint64_t interval) {
+    snapshotInterval = interval;
+    if (interval > 0) {
+        scheduler.Schedule(Scheduler::Snapshot, instructionCount + interval);
+    } else {
+        scheduler.Cancel(Scheduler::Snapshot);
+    }
+}
+
+void Chip8::QueueInput(uint64_t cycle, uint16_t keys) {
+    inputQueue.push_back({cycle, keys});
+    if (inputQueue.size() == 1) {
+        scheduler.Schedule(Scheduler::Input, cycle);
+    }
+}
+
+uint64_t Chip8::InstructionCount() const {
+    return instructionCount;
+}
+
+uint64_t Chip8::FrameCount() const {
+    return frameCount;
+}
+
+Chip8::StopReason Chip8::RunCycles(unsigned int count) {
+    return RunUntil(count, 0);
+}
+
+Chip8::StopReason Chip8::RunUntilFrame(unsigned int stops) {
+    uint64_t frameEnd = scheduler.When(Scheduler::VBlank);
+    StopReason reason = RunUntil(static_cast<unsigned int>(frameEnd - instructionCount), stops);
+    return instructionCount >= frameEnd ? StopReason::Frame : reason;
+}
+
+Chip8::StopReason Chip8::RunUntil(unsigned int count, unsigned int stops) {
+    stopMask = stops;
+    stopRequested = false;
+
+    // Events the host scheduled in the past, such as input queued late, are handled first
+    if (instructionCount >= scheduler.Next()) {
+        DispatchEvents();
+    }
+
+    // The cores run flat out in slices that end on the next scheduled event,
+    // which is handled between slices; they never look at guest time themselves
+    unsigned int executed = 0;
+    while (executed < count && !stopRequested) {
+        unsigned int slice = static_cast<unsigned int>(std::min<uint64_t>(count - executed, scheduler.Next() - instructionCount));
+        unsigned int ran = 0;
+        if ((stops & StopOnBreakpoint) && breakpointCount > 0) {
+            ran = RunToBreakpoint(slice);
+        } else {
+            switch (core) {
+                case Core::Interpreter: ran = RunInterpreter(slice); break;
+                case Core::Threaded: ran = RunThreaded(slice); break;
+                case Core::Cached: ran = RunCached(slice); break;
+                case Core::Jit: ran = RunJit(slice); break;
+                case Core::Static: ran = RunStatic(slice); break;
+            }
+        }
+
+        executed += ran;
+        instructionCount += ran;
+        if (instructionCount >= scheduler.Next()) {
+            DispatchEvents();
+        }
+    }
+
+    stopMask = 0;
+    if (stopRequested) {
+        stopRequested = false;
+        resumeAtBreakpoint = stopReason == StopReason::Breakpoint;
+        return stopReason;
+    }
+    resumeAtBreakpoint = false;
+    return StopReason::Budget;
+}
+
+void Chip8::DispatchEvents() {
+    unsigned int fired = scheduler.TakeDue(instructionCount);
+
+    if (fired & (1u << Scheduler::TimerTick)) {
+        TickTimers();
+        scheduler.Schedule(Scheduler::TimerTick, instructionCount + instructionsPerFrame);
+    }
+    if (fired & (1u << Scheduler::VBlank)) {
+        ++frameCount;
+        scheduler.Schedule(Scheduler::VBlank, instructionCount + instructionsPerFrame);
+    }
+    if (fired & (1u << Scheduler::Input)) {
+        // Apply every entry that is due; a parked Fx0A sees the new keys in the next slice
+        while (!inputQueue.empty() && inputQueue.front().cycle <= instructionCount) {
+            for (unsigned int key = 0; key < KEY_COUNT; ++key) {
+                keypad[key] = (inputQueue.front().keys >> key) & 1u;
+            }
+            inputQueue.pop_front();
+        }
+        if (!inputQueue.empty()) {
+            scheduler.Schedule(Scheduler::Input, inputQueue.front().cycle);
+        }
+    }
+    if (fired & (1u << Scheduler::Breakpoint)) {
+        RequestStop(StopOnBreakpoint, StopReason::Breakpoint);
+    }
+    if (fired & (1u << Scheduler::Snapshot)) {
+        scheduler.Schedule(Scheduler::Snapshot, instructionCount + snapshotInterval);
+        RequestStop(StopOnSnapshot, StopReason::Snapshot);
+    }
+}
+
+void Chip8::RequestStop(StopOn condition, StopReason reason) {
+    if (stopMask & condition) {
+        stopRequested = true;
+        stopReason = reason;
+    }
+}
+
+unsigned int Chip8::RunInterpreter(unsigned int count) {
+    unsigned int executed = 0;
+    while (executed < count && !stopRequested) {
+        if (waitingForKey) {
+            executed += WaitForKey(count - executed);
+            continue;
+        }
+        Cycle();
+        ++executed;
+    }
+    return executed;
+}
+
+unsigned int Chip8::RunToBreakpoint(unsigned int count) {
+    // Breakpoints can sit on any instruction, so step one at a time. The
+    // instruction under a breakpoint the previous batch stopped on runs first.
+    unsigned int executed = 0;
+    bool resume = resumeAtBreakpoint;
+    resumeAtBreakpoint = false;
+    while (executed < count && !stopRequested) {
+        if (!resume && breakpoints[pc & ADDRESS_MASK]) {
+            RequestStop(StopOnBreakpoint, StopReason::Breakpoint);
+            break;
+        }
+        resume = false;
+        executed += RunInterpreter(1);
+    }
+    return executed;
+}
+
+void Chip8::Cycle() {
+    if (waitingForKey) {
+        WaitForKey(1);
+        return;
+    }
+
+    uint16_t opcode = (memory[pc & ADDRESS_MASK] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
+    pc += 2;
 
-void Chip8::OP_00E0() {
+    Instruction const& in = decodeTable[opcode];
+    (this->*in.handler)(in);
+}
+
+// All opcode function definitions below. Operands come pre-extracted from the decode table.
+void Chip8::OP_NULL(Instruction const&) {}
+
+void Chip8::OP_00E0(Instruction const&) {
     memset(video, 0, sizeof(video));
+    dirtyRows = ~0u;
+    RequestStop(StopOnDraw, StopReason::Draw);
 }
 
-void Chip8::OP_00EE() {
+void Chip8::OP_00EE(Instruction const&) {
     --sp;
-    pc = stack[sp];
+    pc = stack[sp % STACK_LEVELS];
 }
 
-void Chip8::OP_1nnn() {
-    uint16_t address = opcode & 0x0FFFu;
-    pc = address;
+void Chip8::OP_1nnn(Instruction const& in) {
+    pc = in.nnn;
 }
 
-void Chip8::OP_2nnn() {
-    uint16_t address = opcode & 0x0FFFu;
-    stack[sp] = pc;
+void Chip8::OP_2nnn(Instruction const& in) {
+    stack[sp % STACK_LEVELS] = pc;
     ++sp;
-    pc = address;
+    pc = in.nnn;
 }
 
-void Chip8::OP_3xkk() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
-    if (registers[Vx] == byte) {
+void Chip8::OP_3xkk(Instruction const& in) {
+    if (registers[in.x] == in.kk) {
         pc += 2;
     }
 }
 
-void Chip8::OP_4xkk() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
-    if (registers[Vx] != byte) {
+void Chip8::OP_4xkk(Instruction const& in) {
+    if (registers[in.x] != in.kk) {
         pc += 2;
     }
 }
 
-void Chip8::OP_5xy0() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    if (registers[Vx] == registers[Vy]) {
+void Chip8::OP_5xy0(Instruction const& in) {
+    if (registers[in.x] == registers[in.y]) {
         pc += 2;
     }
 }
 
-void Chip8::OP_6xkk() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
-    registers[Vx] = byte;
+void Chip8::OP_6xkk(Instruction const& in) {
+    registers[in.x] = in.kk;
 }
 
-void Chip8::OP_7xkk() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
-    registers[Vx] += byte;
+void Chip8::OP_7xkk(Instruction const& in) {
+    registers[in.x] += in.kk;
 }
 
-void Chip8::OP_8xy0() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[Vx] = registers[Vy];
+void Chip8::OP_8xy0(Instruction const& in) {
+    registers[in.x] = registers[in.y];
 }
 
-void Chip8::OP_8xy1() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[Vx] |= registers[Vy];
+void Chip8::OP_8xy1(Instruction const& in) {
+    registers[in.x] |= registers[in.y];
 }
 
-void Chip8::OP_8xy2() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[Vx] &= registers[Vy];
+void Chip8::OP_8xy2(Instruction const& in) {
+    registers[in.x] &= registers[in.y];
 }
 
-void Chip8::OP_8xy3() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[Vx] ^= registers[Vy];
+void Chip8::OP_8xy3(Instruction const& in) {
+    registers[in.x] ^= registers[in.y];
 }
 
-void Chip8::OP_8xy4() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    uint16_t sum = registers[Vx] + registers[Vy];
+void Chip8::OP_8xy4(Instruction const& in) {
+    uint16_t sum = registers[in.x] + registers[in.y];
     registers[0xF] = (sum > 255u);
-    registers[Vx] = sum & 0xFFu;
+    registers[in.x] = sum & 0xFFu;
 }
 
-void Chip8::OP_8xy5() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[0xF] = (registers[Vx] > registers[Vy]);
-    registers[Vx] -= registers[Vy];
+void Chip8::OP_8xy5(Instruction const& in) {
+    registers[0xF] = (registers[in.x] > registers[in.y]);
+    registers[in.x] -= registers[in.y];
 }
 
-void Chip8::OP_8xy6() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    registers[0xF] = registers[Vx] & 0x1u;
-    registers[Vx] >>= 1;
+template <typename Quirks>
+void Chip8::OP_8xy6(Instruction const& in) {
+    if constexpr (Quirks::shiftReadsVy) {
+        registers[in.x] = registers[in.y];
+    }
+    registers[0xF] = registers[in.x] & 0x1u;
+    registers[in.x] >>= 1;
 }
 
-void Chip8::OP_8xy7() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    registers[0xF] = (registers[Vy] > registers[Vx]);
-    registers[Vx] = registers[Vy] - registers[Vx];
+void Chip8::OP_8xy7(Instruction const& in) {
+    registers[0xF] = (registers[in.y] > registers[in.x]);
+    registers[in.x] = registers[in.y] - registers[in.x];
 }
 
-void Chip8::OP_8xyE() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
-    registers[Vx] <<= 1;
+template <typename Quirks>
+void Chip8::OP_8xyE(Instruction const& in) {
+    if constexpr (Quirks::shiftReadsVy) {
+        registers[in.x] = registers[in.y];
+    }
+    registers[0xF] = (registers[in.x] & 0x80u) >> 7u;
+    registers[in.x] <<= 1;
 }
 
-void Chip8::OP_9xy0() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    if (registers[Vx] != registers[Vy]) {
+void Chip8::OP_9xy0(Instruction const& in) {
+    if (registers[in.x] != registers[in.y]) {
         pc += 2;
     }
 }
 
-void Chip8::OP_Annn() {
-    uint16_t address = opcode & 0x0FFFu;
-    index = address;
+void Chip8::OP_Annn(Instruction const& in) {
+    index = in.nnn;
 }
 
-void Chip8::OP_Bnnn() {
-    uint16_t address = opcode & 0x0FFFu;
-    pc = registers[0] + address;
+template <typename Quirks>
+void Chip8::OP_Bnnn(Instruction const& in) {
+    pc = registers[Quirks::jumpUsesVx ? in.x : 0] + in.nnn;
 }
 
-void Chip8::OP_Cxkk() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
-    registers[Vx] = randByte(randGen) & byte;
+void Chip8::OP_Cxkk(Instruction const& in) {
+    registers[in.x] = randByte(randGen) & in.kk;
 }
 
-void Chip8::OP_Dxyn() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-    uint8_t height = opcode & 0x000Fu;
-    uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
-    uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
+template <typename Quirks>
+void Chip8::OP_Dxyn(Instruction const& in) {
+    uint8_t xPos = registers[in.x] % VIDEO_WIDTH;
+    uint8_t yPos = registers[in.y] % VIDEO_HEIGHT;
     registers[0xF] = 0;
 
-    for (unsigned int row = 0; row < height; ++row) {
-        uint8_t spriteByte = memory[index + row];
-        for (unsigned int col = 0; col < 8; ++col) {
-            uint8_t spritePixel = spriteByte & (0x80u >> col);
-            uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
-            if (spritePixel) {
-                if (*screenPixel == 0xFFFFFFFF) {
-                    registers[0xF] = 1;
-                }
-                *screenPixel ^= 0xFFFFFFFF;
-            }
+    // The sprite origin always wraps; its pixels are clipped at the screen edges unless the policy wraps them
+    unsigned int rows = Quirks::wrapSprites ? in.n : std::min<unsigned int>(in.n, VIDEO_HEIGHT - yPos);
+
+    uint64_t collision = 0;
+    if (spriteCacheEnabled && rows > 0) {
+        uint64_t const* sprite = ShiftedSprite<Quirks>(index & ADDRESS_MASK, in.n, xPos);
+        for (unsigned int row = 0; row < rows; ++row) {
+            uint64_t& screenRow = video[(yPos + row) % VIDEO_HEIGHT];
+            collision |= screenRow & sprite[row];
+            screenRow ^= sprite[row];
+        }
+    } else {
+        for (unsigned int row = 0; row < rows; ++row) {
+            uint64_t spriteRow = static_cast<uint64_t>(memory[(index + row) & ADDRESS_MASK]) << (VIDEO_WIDTH - 8);
+            uint64_t mask = Quirks::wrapSprites ? RotateRight(spriteRow, xPos) : spriteRow >> xPos;
+            uint64_t& screenRow = video[(yPos + row) % VIDEO_HEIGHT];
+            collision |= screenRow & mask;
+            screenRow ^= mask;
         }
     }
+    registers[0xF] = collision != 0;
+
+    // Rotate the drawn rows into place; a clipped sprite never reaches the wrapped part
+    uint32_t rowMask = (1u << rows) - 1;
+    dirtyRows |= (rowMask << yPos) | (rowMask >> ((VIDEO_HEIGHT - yPos) & 31));
+
+    RequestStop(StopOnDraw, StopReason::Draw);
 }
 
-void Chip8::OP_Ex9E() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t key = registers[Vx];
-    if (keypad[key]) {
+void Chip8::OP_Ex9E(Instruction const& in) {
+    uint8_t key = registers[in.x];
+    if (keypad[key & 0xFu]) {
         pc += 2;
     }
 }
 
-void Chip8::OP_ExA1() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t key = registers[Vx];
-    if (!keypad[key]) {
+void Chip8::OP_ExA1(Instruction const& in) {
+    uint8_t key = registers[in.x];
+    if (!keypad[key & 0xFu]) {
         pc += 2;
     }
 }
 
-void Chip8::OP_Fx07() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    registers[Vx] = delayTimer;
+void Chip8::OP_Fx07(Instruction const& in) {
+    registers[in.x] = delayTimer;
 }
 
-void Chip8::OP_Fx0A() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+void Chip8::OP_Fx0A(Instruction const& in) {
     for (uint8_t i = 0; i < 16; ++i) {
         if (keypad[i]) {
-            registers[Vx] = i;
+            registers[in.x] = i;
             return;
         }
     }
-    pc -= 2;
+    waitingForKey = true;
+    keyRegister = in.x;
 }
 
-void Chip8::OP_Fx15() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    delayTimer = registers[Vx];
+void Chip8::OP_Fx15(Instruction const& in) {
+    delayTimer = registers[in.x];
 }
 
-void Chip8::OP_Fx18() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    soundTimer = registers[Vx];
+void Chip8::OP_Fx18(Instruction const& in) {
+    soundTimer = registers[in.x];
 }
 
-void Chip8::OP_Fx1E() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    index += registers[Vx];
+void Chip8::OP_Fx1E(Instruction const& in) {
+    index += registers[in.x];
 }
 
-void Chip8::OP_Fx29() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t digit = registers[Vx];
+void Chip8::OP_Fx29(Instruction const& in) {
+    uint8_t digit = registers[in.x];
     index = FONTSET_START_ADDRESS + (5 * digit);
 }
 
-void Chip8::OP_Fx33() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t value = registers[Vx];
-    memory[index + 2] = value % 10;
+void Chip8::OP_Fx33(Instruction const& in) {
+    uint8_t value = registers[in.x];
+    memory[(index + 2) & ADDRESS_MASK] = value % 10;
     value /= 10;
-    memory[index + 1] = value % 10;
+    memory[(index + 1) & ADDRESS_MASK] = value % 10;
     value /= 10;
-    memory[index] = value % 10;
+    memory[index & ADDRESS_MASK] = value % 10;
+
+    for (uint16_t i = 0; i < 3; ++i) {
+        InvalidateCode(index + i);
+    }
 }
 
-void Chip8::OP_Fx55() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    for (uint8_t i = 0; i <= Vx; ++i) {
-        memory[index + i] = registers[i];
+template <typename Quirks>
+void Chip8::OP_Fx55(Instruction const& in) {
+    for (uint8_t i = 0; i <= in.x; ++i) {
+        memory[(index + i) & ADDRESS_MASK] = registers[i];
+        InvalidateCode(index + i);
+    }
+    if constexpr (Quirks::loadStoreAdvancesIndex) {
+        index += in.x + 1;
     }
 }
 
-void Chip8::OP_Fx65() {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    for (uint8_t i = 0; i <= Vx; ++i) {
-        registers[i] = memory[index + i];
+template <typename Quirks>
+void Chip8::OP_Fx65(Instruction const& in) {
+    for (uint8_t i = 0; i <= in.x; ++i) {
+        registers[i] = memory[(index + i) & ADDRESS_MASK];
+    }
+    if constexpr (Quirks::loadStoreAdvancesIndex) {
+        index += in.x + 1;
     }
-}
\ No newline at end of file
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "Quirks.hpp"
+#include "Scheduler.hpp"
 #include <cstdint>
+#include <deque>
+#include <memory>
 #include <random>
-#include <map>
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int MEMORY_SIZE = 4096;
@@ -10,70 +13,301 @@ const unsigned int REGISTER_COUNT = 16;
 const unsigned int STACK_LEVELS = 16;
 const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int VIDEO_WIDTH = 64;
+const unsigned int FONTSET_START_ADDRESS = 0x50;
+const unsigned int START_ADDRESS = 0x200;
+const unsigned int ADDRESS_MASK = MEMORY_SIZE - 1;
+const unsigned int MAX_SPRITE_HEIGHT = 15;
+const unsigned int SPRITE_CACHE_SIZE = 64;
+
+class Jit;
+class StaticCore;
 
 class Chip8
 {
 public:
-    Chip8();
+    // Execution engines; all of them produce identical guest state
+    enum class Core
+    {
+        Interpreter,    // Cycle() through the predecoded dispatch table
+        Threaded,       // Direct-threaded dispatch (labels-as-values)
+        Cached,         // Per-address predecoded instruction cache with superinstructions
+        Jit,            // x86-64 basic-block recompiler
+        Static          // ROM compiled ahead of time by chip8_aot
+    };
+
+    // Why a batch returned
+    enum class StopReason
+    {
+        Budget,         // Ran every instruction it was given
+        Frame,          // RunUntilFrame() completed the current frame
+        Draw,           // The last instruction was 00E0 or Dxyn
+        KeyWait,        // Parked on Fx0A with no key down
+        Breakpoint,     // pc is on a breakpoint, or guest time reached a cycle breakpoint; the instruction at pc has not run yet
+        Snapshot        // Guest time reached a snapshot point
+    };
+
+    // Conditions a batch may stop early on; combine with |
+    enum StopOn : unsigned int
+    {
+        StopOnDraw = 1u << 0,
+        StopOnKeyWait = 1u << 1,
+        StopOnBreakpoint = 1u << 2,
+        StopOnSnapshot = 1u << 3
+    };
+
+    explicit Chip8(Variant variant = Variant::Modern);
+    explicit Chip8(unsigned int seed, Variant variant = Variant::Modern);
+    ~Chip8();
     void LoadROM(char const* filename);
     void Cycle();
-    using OpcodeFunc = void (Chip8::*)();
-    std::map<uint16_t, OpcodeFunc> opcodeMap;
+    bool StateEquals(Chip8 const& other) const;
+
+    // Batch execution on the core chosen with SetCore(). RunUntil() executes at
+    // most count instructions and returns as soon as one of the requested stop
+    // conditions fires; RunUntilFrame() finishes the current frame of
+    // InstructionsPerFrame() instructions. Without StopOnKeyWait a parked Fx0A
+    // spends the batch waiting out guest time.
+    //
+    // Guest time is counted in cycles, one per instruction, and a guest frame
+    // (1/60 s) is InstructionsPerFrame() cycles. The batch entry points run the
+    // core flat out up to the next scheduled event (timer tick, end of frame,
+    // replayed input, cycle breakpoint, snapshot point) and handle it there, so
+    // the timers tick exactly once at the end of each frame; Cycle() on its own
+    // never touches them.
+    void SetCore(Core core);
+    void SetInstructionsPerFrame(unsigned int count);
+    unsigned int InstructionsPerFrame() const;
+    StopReason RunCycles(unsigned int count);
+    StopReason RunUntilFrame(unsigned int stops = 0);
+    StopReason RunUntil(unsigned int count, unsigned int stops);
+    void SetBreakpoint(uint16_t address, bool enabled = true);
+
+    // Stops a batch with StopOnBreakpoint once guest time reaches cycle
+    void SetCycleBreakpoint(uint64_t cycle);
+
+    // Every interval cycles, a batch with StopOnSnapshot returns so the host
+    // can save state at a reproducible point; 0 disables
+    void SetSnapshotInterval(uint64_t interval);
+
+    // Keypad replay: at guest cycle `cycle` the keypad becomes keys, bit k for
+    // key k. Entries must be queued in cycle order; past cycles apply at once.
+    void QueueInput(uint64_t cycle, uint16_t keys);
+
+    // Guest time: instructions retired through the batch entry points, and timer ticks
+    uint64_t InstructionCount() const;
+    uint64_t FrameCount() const;
+
+    // Pre-shifted sprite cache for Dxyn, off by default: with one shift per
+    // sprite row the lookup rarely beats recomputing. The counters report the
+    // lookups served from, and filled into, the cache.
+    void SetSpriteCache(bool enabled);
+    uint64_t SpriteCacheHits() const;
+    uint64_t SpriteCacheMisses() const;
+
+    // The individual cores; each returns the number of instructions it retired,
+    // which is count unless a stop condition fired
+    unsigned int RunInterpreter(unsigned int count);
+    unsigned int RunThreaded(unsigned int count);
+    unsigned int RunCached(unsigned int count);
+    unsigned int RunJit(unsigned int count);
+    unsigned int RunStatic(unsigned int count);
+
+    // Picks the quirk policy a ROM file most likely expects
+    static Variant DetectVariant(char const* filename);
+
+    // True while Fx0A is parked waiting for a key; batches spent in this state
+    // only advance guest time, and the host may block until input arrives
+    bool WaitingForKey() const;
+
+    // Opcode pattern such as "Dxyn", and the opcode about to execute; used by the pair-frequency report
+    static char const* OpcodeName(uint16_t opcode);
+    uint16_t NextOpcode() const;
 
     uint8_t keypad[KEY_COUNT]{};
-    uint32_t video[VIDEO_WIDTH*VIDEO_HEIGHT]{};
+    // One bit per pixel, one row per word; x = 0 is the most significant bit
+    uint64_t video[VIDEO_HEIGHT]{};
+
+    // Copies the framebuffer as 8 bytes per row, leftmost pixel in the most significant bit
+    void PackVideo(uint8_t* bytes) const;
+
+    // Rows written by 00E0 or Dxyn since the last call, bit y for row y
+    uint32_t TakeDirtyRows();
+
+    // 64-bit signature of the framebuffer; equal frames give equal hashes
+    uint64_t VideoHash() const;
 
 private:
-    // Opcode instruction tables
-    typedef void (Chip8::*Chip8Func)();
-    Chip8Func table[0xF + 1];
-    Chip8Func table0[0xE + 1];
-    Chip8Func table8[0xE + 1];
-    Chip8Func tableE[0xE + 1];
-    Chip8Func tableF[0x65 + 1];
-
-    // Helper functions for opcode decoding
-    void Table0();
-    void Table8();
-    void TableE();
-    void TableF();
+    friend class Jit;
+    friend class StaticRom;
+    friend class StaticCore;
+
+    // Decoded form of an opcode: handler plus pre-extracted operands
+    struct Instruction;
+    using OpcodeFunc = void (Chip8::*)(Instruction const&);
+
+    // Handler identifiers, in the same order as the OP_ functions below
+    enum class OpId : uint8_t
+    {
+        OP_NULL, OP_00E0, OP_00EE, OP_1nnn, OP_2nnn, OP_3xkk, OP_4xkk, OP_5xy0,
+        OP_6xkk, OP_7xkk, OP_8xy0, OP_8xy1, OP_8xy2, OP_8xy3, OP_8xy4, OP_8xy5,
+        OP_8xy6, OP_8xy7, OP_8xyE, OP_9xy0, OP_Annn, OP_Bnnn, OP_Cxkk, OP_Dxyn,
+        OP_Ex9E, OP_ExA1, OP_Fx07, OP_Fx0A, OP_Fx15, OP_Fx18, OP_Fx1E, OP_Fx29,
+        OP_Fx33, OP_Fx55, OP_Fx65, Count
+    };
+
+    // Idioms RunCached() executes as a single superinstruction
+    enum class Fusion : uint8_t
+    {
+        None,
+        DelaySpin,      // Fx07, 3xkk, 1nnn: poll the delay timer
+        CountedLoop,    // 7xkk, 3xkk, 1nnn: step a counter until it hits a limit
+        LoadLoadDraw,   // 6xkk, 6ykk, Dxyn: position a sprite and draw it
+        IndexDraw,      // Annn, Dxyn: point I at a sprite and draw it
+        IdleLoop,       // Head of a loop SkipIdleLoop() can fast-forward
+        KeyWait         // Fx0A: park in WaitForKey() for the rest of the batch
+    };
+
+    struct Instruction
+    {
+        OpcodeFunc handler;
+        uint16_t nnn;
+        uint8_t x;
+        uint8_t y;
+        uint8_t n;
+        uint8_t kk;
+        OpId op;
+        Fusion fusion;  // Only set in the icache, on the first instruction of an idiom
+    };
+
+    // Opcode decoding; each quirk policy has one 64K-entry table shared by all
+    // instances, which binds the quirk-dependent opcodes to that policy's handlers
+    template <typename Quirks>
+    static Instruction Decode(uint16_t opcode);
+    template <typename Quirks>
+    static Instruction const* DecodeTable();
+    static Instruction const* DecodeTable(Variant variant);
+    Variant variant;
+    Instruction const* decodeTable{};
+
+    template <typename Quirks>
+    unsigned int RunThreadedWith(unsigned int count);
+
+    // Batch state. Handlers that can end a batch set stopRequested when their
+    // condition is in stopMask; the cores only test it after those handlers.
+    Core core{Core::Interpreter};
+    unsigned int stopMask{};
+    bool stopRequested{};
+    StopReason stopReason{};
+    void RequestStop(StopOn condition, StopReason reason);
+    unsigned int RunToBreakpoint(unsigned int count);
+    bool breakpoints[MEMORY_SIZE]{};
+    unsigned int breakpointCount{};
+    bool resumeAtBreakpoint{};
+    unsigned int instructionsPerFrame;
+    uint64_t instructionCount{};
+    uint64_t frameCount{};
+
+    // Guest-time events, on the instructionCount clock. DispatchEvents() runs
+    // the handlers of every event due and re-arms the periodic ones.
+    struct InputEvent
+    {
+        uint64_t cycle;
+        uint16_t keys;
+    };
+    Scheduler scheduler;
+    std::deque<InputEvent> inputQueue;
+    uint64_t snapshotInterval{};
+    void DispatchEvents();
+
+    // Per-address decoded instructions, filled lazily by RunCached(); a null
+    // handler marks an empty slot. Guest writes to memory invalidate the slots
+    // that overlap the written byte.
+    Instruction icache[MEMORY_SIZE]{};
+    void InvalidateCode(uint16_t address);
+
+    // Sprite rows already shifted to their x position, ready to XOR into the
+    // framebuffer. Direct-mapped on (address, height, x); guest writes drop
+    // the entries whose sprite bytes they overlap.
+    struct SpriteCacheEntry
+    {
+        uint32_t key;           // SpriteKey(); zero marks an empty entry
+        uint64_t rows[MAX_SPRITE_HEIGHT];
+    };
+    SpriteCacheEntry spriteCache[SPRITE_CACHE_SIZE]{};
+    bool spriteCacheEnabled{};
+    uint64_t spriteCacheHits{};
+    uint64_t spriteCacheMisses{};
+    template <typename Quirks>
+    uint64_t const* ShiftedSprite(uint16_t address, uint8_t height, uint8_t shift);
+    void InvalidateSprites(uint16_t address);
+    void FlushSpriteCache();
+
+    // Superinstructions; the covered opcodes are re-read from memory, which is
+    // safe because any write to them invalidates the fused slot
+    Fusion MatchFusion(uint16_t address) const;
+    unsigned int RunFused(Instruction const& in, unsigned int budget);
+
+    // Idle-loop fast-forward. Only two shapes are recognised, neither of which
+    // writes memory or reads the keypad: a jump to itself, and Fx07 / 3xkk /
+    // 1nnn polling the delay timer. Core slices never cross a timer tick, so
+    // SkipIdleLoop() either skips every whole iteration that fits in budget or
+    // none, and returns the number of instructions skipped.
+    unsigned int IdleLoopLength(uint16_t head) const;
+    unsigned int SkipIdleLoop(unsigned int budget);
+    void TickTimers();
+
+    // Blocking key wait. Fx0A with no key down sets waitingForKey instead of
+    // re-executing itself; WaitForKey() then completes it once a key is down,
+    // or spends the whole budget waiting, since the keypad cannot
+    // change until the host runs again. Returns the instructions accounted for.
+    unsigned int WaitForKey(unsigned int budget);
+
+    // Created on the first RunJit() / RunStatic() call
+    std::unique_ptr<Jit> jit;
+    std::unique_ptr<StaticCore> staticCore;
 
     // Individual opcode functions
-    void OP_NULL();      // Do nothing
-    void OP_00E0();      // CLS
-    void OP_00EE();      // RET
-    void OP_1nnn();      // JP address
-    void OP_2nnn();      // CALL address
-    void OP_3xkk();      // SE Vx, byte
-    void OP_4xkk();      // SNE Vx, byte
-    void OP_5xy0();      // SE Vx, Vy
-    void OP_6xkk();      // LD Vx, byte
-    void OP_7xkk();      // ADD Vx, byte
-    void OP_8xy0();      // LD Vx, Vy
-    void OP_8xy1();      // OR Vx, Vy
-    void OP_8xy2();      // AND Vx, Vy
-    void OP_8xy3();      // XOR Vx, Vy
-    void OP_8xy4();      // ADD Vx, Vy
-    void OP_8xy5();      // SUB Vx, Vy
-    void OP_8xy6();      // SHR Vx
-    void OP_8xy7();      // SUBN Vx, Vy
-    void OP_8xyE();      // SHL Vx
-    void OP_9xy0();      // SNE Vx, Vy
-    void OP_Annn();      // LD I, address
-    void OP_Bnnn();      // JP V0, address
-    void OP_Cxkk();      // RND Vx, byte
-    void OP_Dxyn();      // DRW Vx, Vy, height
-    void OP_Ex9E();      // SKP Vx
-    void OP_ExA1();      // SKNP Vx
-    void OP_Fx07();      // LD Vx, DT
-    void OP_Fx0A();      // LD Vx, K
-    void OP_Fx15();      // LD DT, Vx
-    void OP_Fx18();      // LD ST, Vx
-    void OP_Fx1E();      // ADD I, Vx
-    void OP_Fx29();      // LD F, Vx
-    void OP_Fx33();      // LD B, Vx
-    void OP_Fx55();      // LD [I], Vx
-    void OP_Fx65();      // LD Vx, [I]
+    void OP_NULL(Instruction const& in);        // Do nothing
+    void OP_00E0(Instruction const& in);        // CLS
+    void OP_00EE(Instruction const& in);        // RET
+    void OP_1nnn(Instruction const& in);        // JP address
+    void OP_2nnn(Instruction const& in);        // CALL address
+    void OP_3xkk(Instruction const& in);        // SE Vx, byte
+    void OP_4xkk(Instruction const& in);        // SNE Vx, byte
+    void OP_5xy0(Instruction const& in);        // SE Vx, Vy
+    void OP_6xkk(Instruction const& in);        // LD Vx, byte
+    void OP_7xkk(Instruction const& in);        // ADD Vx, byte
+    void OP_8xy0(Instruction const& in);        // LD Vx, Vy
+    void OP_8xy1(Instruction const& in);        // OR Vx, Vy
+    void OP_8xy2(Instruction const& in);        // AND Vx, Vy
+    void OP_8xy3(Instruction const& in);        // XOR Vx, Vy
+    void OP_8xy4(Instruction const& in);        // ADD Vx, Vy
+    void OP_8xy5(Instruction const& in);        // SUB Vx, Vy
+    template <typename Quirks>
+    void OP_8xy6(Instruction const& in);        // SHR Vx
+    void OP_8xy7(Instruction const& in);        // SUBN Vx, Vy
+    template <typename Quirks>
+    void OP_8xyE(Instruction const& in);        // SHL Vx
+    void OP_9xy0(Instruction const& in);        // SNE Vx, Vy
+    void OP_Annn(Instruction const& in);        // LD I, address
+    template <typename Quirks>
+    void OP_Bnnn(Instruction const& in);        // JP V0, address
+    void OP_Cxkk(Instruction const& in);        // RND Vx, byte
+    template <typename Quirks>
+    void OP_Dxyn(Instruction const& in);        // DRW Vx, Vy, height
+    void OP_Ex9E(Instruction const& in);        // SKP Vx
+    void OP_ExA1(Instruction const& in);        // SKNP Vx
+    void OP_Fx07(Instruction const& in);        // LD Vx, DT
+    void OP_Fx0A(Instruction const& in);        // LD Vx, K
+    void OP_Fx15(Instruction const& in);        // LD DT, Vx
+    void OP_Fx18(Instruction const& in);        // LD ST, Vx
+    void OP_Fx1E(Instruction const& in);        // ADD I, Vx
+    void OP_Fx29(Instruction const& in);        // LD F, Vx
+    void OP_Fx33(Instruction const& in);        // LD B, Vx
+    template <typename Quirks>
+    void OP_Fx55(Instruction const& in);        // LD [I], Vx
+    template <typename Quirks>
+    void OP_Fx65(Instruction const& in);        // LD Vx, [I]
 
     // CPU state and memory
     uint8_t memory[MEMORY_SIZE]{};
@@ -84,7 +318,9 @@ private:
     uint8_t soundTimer{};
     uint16_t stack[STACK_LEVELS]{};
     uint8_t sp{};
-    uint16_t opcode{};
+    uint32_t dirtyRows{~0u};
+    bool waitingForKey{};
+    uint8_t keyRegister{};
     
     // Random number generation
     std::default_random_engine randGen;
@@ -0,0 +1,213 @@
+// Chip8Threaded.cpp
+//
+// Direct-threaded interpreter core. Each handler ends by fetching the next
+// opcode and jumping straight to its label, so there is no call/return per
+// instruction and every handler gets its own indirect branch.
+
+#include "Chip8.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+
+unsigned int Chip8::RunThreaded(unsigned int count) {
+    return WithQuirks(variant, [this, count](auto quirks) {
+        return RunThreadedWith<decltype(quirks)>(count);
+    });
+}
+
+template <typename Quirks>
+unsigned int Chip8::RunThreadedWith(unsigned int count) {
+    // Indexed by OpId
+    static void* const labels[] = {
+        &&op_NULL, &&op_00E0, &&op_00EE, &&op_1nnn, &&op_2nnn, &&op_3xkk, &&op_4xkk,
+        &&op_5xy0, &&op_6xkk, &&op_7xkk, &&op_8xy0, &&op_8xy1, &&op_8xy2, &&op_8xy3,
+        &&op_8xy4, &&op_8xy5, &&op_8xy6, &&op_8xy7, &&op_8xyE, &&op_9xy0, &&op_Annn,
+        &&op_Bnnn, &&op_Cxkk, &&op_Dxyn, &&op_Ex9E, &&op_ExA1, &&op_Fx07, &&op_Fx0A,
+        &&op_Fx15, &&op_Fx18, &&op_Fx1E, &&op_Fx29, &&op_Fx33, &&op_Fx55, &&op_Fx65
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<size_t>(OpId::Count),
+                  "label table out of sync with OpId");
+
+    Instruction const* in;
+    unsigned int const budget = count;
+
+#define DISPATCH()                                                  \
+    do {                                                            \
+        uint16_t opcode = (memory[pc & ADDRESS_MASK] << 8u)         \
+                        | memory[(pc + 1) & ADDRESS_MASK];          \
+        pc += 2;                                                    \
+        in = &decodeTable[opcode];                                  \
+        goto *labels[static_cast<uint8_t>(in->op)];                 \
+    } while (0)
+
+#define RETIRE()                                                    \
+    do {                                                            \
+        if (--count == 0) return budget;                            \
+    } while (0)
+
+#define NEXT()                                                      \
+    do {                                                            \
+        RETIRE();                                                   \
+        DISPATCH();                                                 \
+    } while (0)
+
+// Ends the batch early if the handler just run requested a stop
+#define NEXT_OR_STOP()                                              \
+    do {                                                            \
+        RETIRE();                                                   \
+        if (stopRequested) return budget - count;                   \
+        DISPATCH();                                                 \
+    } while (0)
+
+    count -= WaitForKey(count);
+    if (count == 0 || stopRequested) {
+        return budget - count;
+    }
+    DISPATCH();
+
+op_NULL:
+    NEXT();
+op_00E0:
+    OP_00E0(*in);
+    NEXT_OR_STOP();
+op_00EE:
+    --sp;
+    pc = stack[sp % STACK_LEVELS];
+    NEXT();
+op_1nnn:
+    // A short backward jump may close an idle loop; skip its remaining iterations
+    if (static_cast<uint16_t>(pc - 2 - in->nnn) <= 4) {
+        pc = in->nnn;
+        RETIRE();
+        count -= SkipIdleLoop(count);
+        if (count == 0) return budget;
+        DISPATCH();
+    }
+    pc = in->nnn;
+    NEXT();
+op_2nnn:
+    stack[sp % STACK_LEVELS] = pc;
+    ++sp;
+    pc = in->nnn;
+    NEXT();
+op_3xkk:
+    if (registers[in->x] == in->kk) pc += 2;
+    NEXT();
+op_4xkk:
+    if (registers[in->x] != in->kk) pc += 2;
+    NEXT();
+op_5xy0:
+    if (registers[in->x] == registers[in->y]) pc += 2;
+    NEXT();
+op_6xkk:
+    registers[in->x] = in->kk;
+    NEXT();
+op_7xkk:
+    registers[in->x] += in->kk;
+    NEXT();
+op_8xy0:
+    registers[in->x] = registers[in->y];
+    NEXT();
+op_8xy1:
+    registers[in->x] |= registers[in->y];
+    NEXT();
+op_8xy2:
+    registers[in->x] &= registers[in->y];
+    NEXT();
+op_8xy3:
+    registers[in->x] ^= registers[in->y];
+    NEXT();
+op_8xy4:
+    {
+        uint16_t sum = registers[in->x] + registers[in->y];
+        registers[0xF] = (sum > 255u);
+        registers[in->x] = sum & 0xFFu;
+    }
+    NEXT();
+op_8xy5:
+    registers[0xF] = (registers[in->x] > registers[in->y]);
+    registers[in->x] -= registers[in->y];
+    NEXT();
+op_8xy6:
+    if constexpr (Quirks::shiftReadsVy) registers[in->x] = registers[in->y];
+    registers[0xF] = registers[in->x] & 0x1u;
+    registers[in->x] >>= 1;
+    NEXT();
+op_8xy7:
+    registers[0xF] = (registers[in->y] > registers[in->x]);
+    registers[in->x] = registers[in->y] - registers[in->x];
+    NEXT();
+op_8xyE:
+    if constexpr (Quirks::shiftReadsVy) registers[in->x] = registers[in->y];
+    registers[0xF] = (registers[in->x] & 0x80u) >> 7u;
+    registers[in->x] <<= 1;
+    NEXT();
+op_9xy0:
+    if (registers[in->x] != registers[in->y]) pc += 2;
+    NEXT();
+op_Annn:
+    index = in->nnn;
+    NEXT();
+op_Bnnn:
+    pc = registers[Quirks::jumpUsesVx ? in->x : 0] + in->nnn;
+    NEXT();
+op_Cxkk:
+    OP_Cxkk(*in);
+    NEXT();
+op_Dxyn:
+    // Quirk-dependent; the decode table holds this policy's handler
+    (this->*in->handler)(*in);
+    NEXT_OR_STOP();
+op_Ex9E:
+    if (keypad[registers[in->x] & 0xFu]) pc += 2;
+    NEXT();
+op_ExA1:
+    if (!keypad[registers[in->x] & 0xFu]) pc += 2;
+    NEXT();
+op_Fx07:
+    registers[in->x] = delayTimer;
+    NEXT();
+op_Fx0A:
+    OP_Fx0A(*in);
+    if (waitingForKey) {
+        RETIRE();
+        count -= WaitForKey(count);
+        if (count == 0 || stopRequested) return budget - count;
+        DISPATCH();
+    }
+    NEXT();
+op_Fx15:
+    delayTimer = registers[in->x];
+    NEXT();
+op_Fx18:
+    soundTimer = registers[in->x];
+    NEXT();
+op_Fx1E:
+    index += registers[in->x];
+    NEXT();
+op_Fx29:
+    index = FONTSET_START_ADDRESS + (5 * registers[in->x]);
+    NEXT();
+op_Fx33:
+    OP_Fx33(*in);
+    NEXT();
+op_Fx55:
+    (this->*in->handler)(*in);
+    NEXT();
+op_Fx65:
+    (this->*in->handler)(*in);
+    NEXT();
+
+#undef NEXT_OR_STOP
+#undef NEXT
+#undef RETIRE
+#undef DISPATCH
+}
+
+#else
+
+// No labels-as-values on this compiler; fall back to the table-dispatch interpreter
+unsigned int Chip8::RunThreaded(unsigned int count) {
+    return RunInterpreter(count);
+}
+
+#endif
@@ -0,0 +1,170 @@
+#include "FramePacer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <time.h>
+
+// Low-latency mode wakes this long before the deadline and spins the rest;
+// a little more than the usual timer slack plus scheduler wake-up latency
+const int64_t SPIN_MARGIN_NS = 300000;
+
+// Width of a jitter histogram bucket
+const int64_t HISTOGRAM_BUCKET_NS = 10000;
+
+static int64_t MonotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+static void SleepUntil(int64_t deadlineNs)
+{
+    timespec deadline;
+    deadline.tv_sec = deadlineNs / 1000000000;
+    deadline.tv_nsec = deadlineNs % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+}
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+FramePacer::FramePacer(Mode mode, int64_t intervalNs)
+    : mode(mode), intervalNs(intervalNs)
+{
+    nextDeadline = MonotonicNs();
+}
+
+void FramePacer::WaitForFrame()
+{
+    if (mode == Mode::VsyncLocked) {
+        WaitForVblank();
+    } else if (intervalNs > 0) {
+        WaitForDeadline();
+    }
+    ++stats.frames;
+}
+
+void FramePacer::WaitForDeadline()
+{
+    nextDeadline += intervalNs;
+
+    // Drop the backlog after a stall instead of running frames back to back
+    int64_t now = MonotonicNs();
+    if (nextDeadline <= now) {
+        ++stats.overruns;
+        nextDeadline = now;
+        Record(0);
+        return;
+    }
+
+    if (mode == Mode::PowerSaving) {
+        SleepUntil(nextDeadline);
+        Record(MonotonicNs() - nextDeadline);
+        return;
+    }
+
+    if (nextDeadline - now > SPIN_MARGIN_NS) {
+        SleepUntil(nextDeadline - SPIN_MARGIN_NS);
+    }
+    int64_t spinStart = MonotonicNs();
+    now = spinStart;
+    while (now < nextDeadline) {
+        CpuRelax();
+        now = MonotonicNs();
+    }
+    stats.spinNs += now - spinStart;
+    Record(now - nextDeadline);
+}
+
+void FramePacer::WaitForVblank()
+{
+    std::unique_lock<std::mutex> lock(vblankMutex);
+
+    // A refresh that went by while the frame ran means the guest fell behind the display
+    if (vblankCount > vblankSeen + 1) {
+        ++stats.overruns;
+    }
+    vblankSignal.wait(lock, [this] { return stopped || vblankCount > vblankSeen; });
+    vblankSeen = vblankCount;
+    int64_t signalled = vblankTime;
+    lock.unlock();
+
+    Record(MonotonicNs() - signalled);
+}
+
+void FramePacer::Vblank()
+{
+    {
+        std::lock_guard<std::mutex> lock(vblankMutex);
+        ++vblankCount;
+        vblankTime = MonotonicNs();
+    }
+    vblankSignal.notify_one();
+}
+
+void FramePacer::Resync()
+{
+    nextDeadline = MonotonicNs();
+    std::lock_guard<std::mutex> lock(vblankMutex);
+    vblankSeen = vblankCount;
+}
+
+void FramePacer::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(vblankMutex);
+        stopped = true;
+    }
+    vblankSignal.notify_one();
+}
+
+void FramePacer::Record(int64_t latenessNs)
+{
+    uint64_t lateness = static_cast<uint64_t>(std::max<int64_t>(latenessNs, 0));
+    stats.jitterTotalNs += lateness;
+    stats.jitterMaxNs = std::max(stats.jitterMaxNs, lateness);
+    ++histogram[std::min<uint64_t>(lateness / HISTOGRAM_BUCKET_NS, HISTOGRAM_BUCKETS)];
+}
+
+uint64_t FramePacer::JitterPercentileNs(double fraction) const
+{
+    uint64_t samples = 0;
+    for (uint64_t count : histogram) {
+        samples += count;
+    }
+
+    uint64_t wanted = static_cast<uint64_t>(fraction * samples);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket) {
+        seen += histogram[bucket];
+        if (seen > wanted) {
+            return (bucket + 1) * HISTOGRAM_BUCKET_NS;
+        }
+    }
+    return stats.jitterMaxNs;
+}
+
+FramePacer::Mode FramePacer::ActiveMode() const
+{
+    return mode;
+}
+
+char const* FramePacer::Describe() const
+{
+    switch (mode) {
+        case Mode::PowerSaving: return "power-saving";
+        case Mode::LowLatency: return "low-latency";
+        case Mode::VsyncLocked: return "vsync-locked";
+    }
+    return "";
+}
+
+FramePacer::PacingStats const& FramePacer::Stats() const
+{
+    return stats;
+}
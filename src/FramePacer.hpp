@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Paces the emulation thread to one guest frame per interval without burning
+// a core between frames. Wake-up lateness is recorded for the exit report.
+class FramePacer
+{
+public:
+    enum class Mode
+    {
+        PowerSaving,    // Absolute clock_nanosleep() to the deadline; the kernel's timer slack shows up as jitter
+        LowLatency,     // Sleeps to just short of the deadline, then spins for the last few hundred microseconds
+        VsyncLocked     // One guest frame per display refresh, signalled by the render thread through Vblank()
+    };
+
+    struct PacingStats
+    {
+        uint64_t frames;
+        uint64_t overruns;          // Frames that were already late when the wait began; the backlog is dropped
+        uint64_t jitterTotalNs;     // Sum of wake-up lateness, against the deadline or the vblank signal
+        uint64_t jitterMaxNs;
+        uint64_t spinNs;            // Time spent spinning in low-latency mode
+    };
+
+    // An interval of zero runs frames back to back
+    FramePacer(Mode mode, int64_t intervalNs);
+
+    // Emulation thread: blocks until the next frame is due
+    void WaitForFrame();
+
+    // Render thread, vsync-locked mode: a buffer swap has just returned
+    void Vblank();
+
+    // Starts counting deadlines from now, after frames that were not paced
+    void Resync();
+
+    // Ends any wait for good, so the emulation thread can be joined
+    void Stop();
+
+    Mode ActiveMode() const;
+    char const* Describe() const;
+    PacingStats const& Stats() const;
+
+    // Lateness below which the given fraction of frames woke up, from a histogram
+    uint64_t JitterPercentileNs(double fraction) const;
+
+private:
+    Mode mode;
+    int64_t intervalNs;
+    int64_t nextDeadline{};
+    PacingStats stats{};
+
+    static const int HISTOGRAM_BUCKETS = 1000;
+    uint64_t histogram[HISTOGRAM_BUCKETS + 1]{};    // 10 us buckets up to 10 ms, then everything later
+
+    std::mutex vblankMutex;
+    std::condition_variable vblankSignal;
+    uint64_t vblankCount{};
+    uint64_t vblankSeen{};
+    int64_t vblankTime{};
+    bool stopped{false};
+
+    void WaitForDeadline();
+    void WaitForVblank();
+    void Record(int64_t latenessNs);
+};
@@ -0,0 +1,95 @@
+#include "HeadlessPlatform.hpp"
+#include <chrono>
+
+void NullPlatform::Update(void const*, int, uint32_t dirtyRows)
+{
+    if (dirtyRows == 0) {
+        ++stats.framesSkipped;
+    } else {
+        ++stats.framesPresented;
+    }
+}
+
+bool NullPlatform::ProcessInput(uint8_t*)
+{
+    return false;
+}
+
+void NullPlatform::WaitForInput(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return wakePending; });
+    wakePending = false;
+}
+
+void NullPlatform::Wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakePending = true;
+    }
+    wakeCondition.notify_one();
+}
+
+char const* NullPlatform::Describe() const
+{
+    return "null (frames discarded)";
+}
+
+FilePlatform::FilePlatform(char const* path, int width, int height, Format format, Palette const& palette)
+    : file(path, std::ios::binary | std::ios::trunc), width(width), height(height), format(format), palette(palette)
+{
+    if (format == Format::Rgba) {
+        header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height) +
+                 "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+        pixels.resize(static_cast<size_t>(width) * height);
+        description = std::string("file sink, RGBA (") + path + ")";
+    } else {
+        header = "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n";
+        description = std::string("file sink, 1-bpp (") + path + ")";
+    }
+}
+
+bool FilePlatform::IsOpen() const
+{
+    return file.is_open();
+}
+
+void FilePlatform::Update(void const* buffer, int pitch, uint32_t dirtyRows)
+{
+    if (dirtyRows == 0) {
+        ++stats.framesSkipped;
+        return;
+    }
+
+    // Neither format has partial frames, so every changed frame is written whole
+    auto rows = static_cast<uint8_t const*>(buffer);
+    uint64_t frameBytes = 0;
+    file.write(header.data(), header.size());
+    if (format == Format::Rgba) {
+        ExpandToRgba(rows, width, height, pitch, palette, pixels.data());
+        frameBytes = pixels.size() * sizeof(uint32_t);
+        file.write(reinterpret_cast<char const*>(pixels.data()), frameBytes);
+    } else {
+        const int rowBytes = width / 8;
+        for (int y = 0; y < height; ++y) {
+            file.write(reinterpret_cast<char const*>(rows + y * pitch), rowBytes);
+        }
+        frameBytes = static_cast<uint64_t>(rowBytes) * height;
+    }
+
+    ++stats.framesPresented;
+    ++stats.uploadCalls;
+    stats.rowsUploaded += height;
+    stats.bytesUploaded += frameBytes;
+}
+
+bool FilePlatform::PresentsEveryFrame() const
+{
+    return true;
+}
+
+char const* FilePlatform::Describe() const
+{
+    return description.c_str();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "Present.hpp"
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Discards every frame and never reports input; for build hosts and batch
+// jobs. Nothing here touches SDL or GL.
+class NullPlatform : public Platform
+{
+public:
+    void Update(void const* buffer, int pitch, uint32_t dirtyRows) override;
+    bool ProcessInput(uint8_t* keys) override;
+    void WaitForInput(int timeoutMs) override;
+    void Wake() override;
+    char const* Describe() const override;
+
+private:
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool wakePending{false};
+};
+
+// Appends every changed frame to a file as an image stream that netpbm tools
+// and ffmpeg's image2pipe can read
+class FilePlatform : public NullPlatform
+{
+public:
+    enum class Format
+    {
+        Bitmap,     // PBM (P4): the packed 1-bpp rows as they are
+        Rgba        // PAM (P7, RGB_ALPHA): each frame expanded through the palette
+    };
+
+    FilePlatform(char const* path, int width, int height, Format format, Palette const& palette);
+
+    bool IsOpen() const;
+
+    void Update(void const* buffer, int pitch, uint32_t dirtyRows) override;
+    bool PresentsEveryFrame() const override;
+    char const* Describe() const override;
+
+private:
+    std::ofstream file;
+    std::string header;
+    std::string description;
+    int width;
+    int height;
+    Format format;
+    Palette palette;
+    std::vector<uint32_t> pixels;
+};
@@ -0,0 +1,588 @@
+// Jit.cpp
+
+#include "Jit.hpp"
+#include <cstddef>
+#include <cstring>
+
+#if CHIP8_JIT_X64
+
+#include <sys/mman.h>
+
+const size_t CODE_SIZE = 1 << 20;
+const size_t MAX_BLOCK_BYTES = 16384;
+const unsigned int MAX_BLOCK_LENGTH = 64;
+
+// Values returned in rax by the exit stub; anything else is a chainable exit site
+const uintptr_t EXIT_PLAIN = 0;
+const uintptr_t EXIT_BAIL = 1;
+
+// x86 register numbers and condition codes used by the emitter
+const uint8_t EAX = 0;
+const uint8_t ECX = 1;
+const uint8_t EDX = 2;
+const uint8_t CC_E = 0x4;
+const uint8_t CC_NE = 0x5;
+const uint8_t CC_A = 0x7;
+const uint8_t CC_S = 0x8;
+
+Jit::Jit(Chip8& chip8)
+    : chip8(chip8)
+{
+    // Never writable and executable at once: emission happens with the buffer
+    // read-write, and Seal() flips it to read-execute before any code runs
+    void* code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return;
+    }
+    writable = true;
+
+    codeStart = static_cast<uint8_t*>(code);
+    codeEnd = codeStart + CODE_SIZE;
+    codePtr = codeStart;
+
+    offRegisters = Offset(&chip8.registers[0]);
+    offIndex = Offset(&chip8.index);
+    offPc = Offset(&chip8.pc);
+    offSp = Offset(&chip8.sp);
+    offStack = Offset(&chip8.stack[0]);
+    offDelayTimer = Offset(&chip8.delayTimer);
+    offSoundTimer = Offset(&chip8.soundTimer);
+    offKeypad = Offset(&chip8.keypad[0]);
+    offStopRequested = Offset(&chip8.stopRequested);
+
+    context.blocks = dynamicTargets;
+
+    WithQuirks(chip8.variant, [this](auto quirks) {
+        shiftReadsVy = decltype(quirks)::shiftReadsVy;
+        jumpUsesVx = decltype(quirks)::jumpUsesVx;
+    });
+
+    EmitStubs();
+    blocksStart = codePtr;
+}
+
+Jit::~Jit() {
+    Release();
+}
+
+void Jit::Release() {
+    if (codeStart) {
+        munmap(codeStart, CODE_SIZE);
+    }
+    codeStart = nullptr;
+    codeEnd = nullptr;
+    codePtr = nullptr;
+    std::memset(blocks, 0, sizeof(blocks));
+    std::memset(dynamicTargets, 0, sizeof(dynamicTargets));
+    std::memset(translated, 0, sizeof(translated));
+    std::memset(idle, 0, sizeof(idle));
+}
+
+void Jit::Unseal() {
+    if (!writable && mprotect(codeStart, CODE_SIZE, PROT_READ | PROT_WRITE) == 0) {
+        writable = true;
+    }
+}
+
+bool Jit::Seal() {
+    // One mprotect() per run of translations and patches, none once every block is chained
+    if (writable) {
+        if (mprotect(codeStart, CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+            return false;
+        }
+        writable = false;
+    }
+    return true;
+}
+
+unsigned int Jit::Run(unsigned int count) {
+    int64_t remaining = count;
+
+    while (remaining > 0 && !chip8.stopRequested) {
+        if (flushPending) {
+            Flush();
+        }
+
+        if (chip8.waitingForKey) {
+            remaining -= chip8.WaitForKey(static_cast<unsigned int>(remaining));
+            continue;
+        }
+
+        uint16_t pc = chip8.pc;
+        if (pc < ADDRESS_MASK && idle[pc]) {
+            remaining -= chip8.SkipIdleLoop(static_cast<unsigned int>(remaining));
+            if (remaining == 0) {
+                break;
+            }
+        }
+
+        uint8_t* block = nullptr;
+        if (pc < ADDRESS_MASK) {
+            block = blocks[pc] ? blocks[pc] : Translate(pc);
+        }
+
+        if (block == nullptr) {
+            chip8.Cycle();
+            --remaining;
+            continue;
+        }
+
+        // A kernel that refuses executable mappings leaves the rest of the run to the threaded core
+        if (!Seal()) {
+            Release();
+            return count - static_cast<unsigned int>(remaining) + chip8.RunThreaded(static_cast<unsigned int>(remaining));
+        }
+
+        uintptr_t exit = enter(&chip8, block, remaining, &context);
+        remaining = context.budget;
+
+        if (exit == EXIT_BAIL) {
+            // Not enough budget left for the whole block, so the batch ends inside
+            // it; interpret the rest rather than translating each suffix
+            remaining -= chip8.RunInterpreter(static_cast<unsigned int>(remaining));
+        } else if (exit != EXIT_PLAIN && !flushPending) {
+            Chain(reinterpret_cast<uint8_t*>(exit));
+        }
+    }
+    return count - static_cast<unsigned int>(remaining);
+}
+
+void Jit::Invalidate(uint16_t address) {
+    if (translated[address & ADDRESS_MASK]) {
+        flushPending = true;
+    }
+}
+
+void Jit::Flush() {
+    if (!codeStart) {
+        return;
+    }
+    codePtr = blocksStart;
+    std::memset(blocks, 0, sizeof(blocks));
+    std::memset(dynamicTargets, 0, sizeof(dynamicTargets));
+    std::memset(translated, 0, sizeof(translated));
+    std::memset(idle, 0, sizeof(idle));
+    flushPending = false;
+    ++generation;
+}
+
+void Jit::Execute(Chip8* chip8, Chip8::Instruction const* in) {
+    (chip8->*in->handler)(*in);
+}
+
+void Jit::Chain(uint8_t* site) {
+    uint16_t target = chip8.pc;
+    if (target >= ADDRESS_MASK) {
+        return;
+    }
+
+    uint8_t* block = blocks[target];
+    if (block == nullptr) {
+        unsigned int before = generation;
+        block = Translate(target);
+        if (generation != before) {
+            // The exit site was discarded by a flush
+            return;
+        }
+    }
+    // Idle loop heads are always entered through the dispatcher so it can skip them
+    if (block && !idle[target]) {
+        Unseal();
+        if (!writable) {
+            return;
+        }
+        Patch(site + 1, block);
+    }
+}
+
+uint8_t* Jit::Translate(uint16_t start) {
+    using OpId = Chip8::OpId;
+
+    // Scan the block first so its length is known for the budget check
+    Chip8::Instruction const* code[MAX_BLOCK_LENGTH];
+    unsigned int length = 0;
+    bool terminated = false;
+
+    for (uint16_t address = start; address < ADDRESS_MASK && length < MAX_BLOCK_LENGTH; address += 2) {
+        uint16_t opcode = (chip8.memory[address] << 8u) | chip8.memory[address + 1];
+        Chip8::Instruction const* in = &chip8.decodeTable[opcode];
+        if (in->op == OpId::OP_Fx0A) {
+            break;
+        }
+
+        code[length++] = in;
+
+        switch (in->op) {
+            case OpId::OP_00EE: case OpId::OP_1nnn: case OpId::OP_2nnn: case OpId::OP_3xkk:
+            case OpId::OP_4xkk: case OpId::OP_5xy0: case OpId::OP_9xy0: case OpId::OP_Bnnn:
+            case OpId::OP_Ex9E: case OpId::OP_ExA1: case OpId::OP_Fx33: case OpId::OP_Fx55:
+                terminated = true;
+                break;
+            default:
+                break;
+        }
+        if (terminated) {
+            break;
+        }
+    }
+
+    if (length == 0) {
+        return nullptr;
+    }
+
+    Unseal();
+    if (!writable) {
+        return nullptr;
+    }
+
+    if (static_cast<size_t>(codeEnd - codePtr) < MAX_BLOCK_BYTES) {
+        Flush();
+    }
+
+    uint8_t* entry = codePtr;
+
+    // sub r12, length ; js bail
+    Emit8(0x49); Emit8(0x81); Emit8(0xEC); Emit32(length);
+    uint8_t* bailJump = codePtr;
+    EmitJcc(CC_S, codePtr);
+
+    uint16_t pc = start;
+
+    for (unsigned int i = 0; i < length; ++i) {
+        Chip8::Instruction const* in = code[i];
+        int32_t vx = offRegisters + in->x;
+        int32_t vy = offRegisters + in->y;
+        int32_t vf = offRegisters + 0xF;
+        uint16_t next = pc + 2;
+
+        switch (in->op) {
+            case OpId::OP_NULL:
+                break;
+            case OpId::OP_00E0:
+            case OpId::OP_Dxyn:
+                EmitCall(in);
+                EmitStopCheck(length - i - 1, next);
+                break;
+            case OpId::OP_Cxkk:
+            case OpId::OP_Fx65:
+                EmitCall(in);
+                break;
+            case OpId::OP_00EE:
+                Emit8(0xFE); EmitMem(1, offSp);                                 // dec byte [sp]
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, offSp);                  // movzx eax, byte [sp]
+                Emit8(0x83); Emit8(0xE0); Emit8(STACK_LEVELS - 1);             // and eax, 15
+                Emit8(0x0F); Emit8(0xB7); Emit8(0x84); Emit8(0x43); Emit32(offStack);  // movzx eax, word [rbx+rax*2+stack]
+                Emit8(0x66); Emit8(0x89); EmitMem(EAX, offPc);                  // mov [pc], ax
+                EmitDynamicExit();
+                break;
+            case OpId::OP_1nnn:
+                EmitChainExit(in->nnn);
+                break;
+            case OpId::OP_2nnn:
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, offSp);                  // movzx eax, byte [sp]
+                Emit8(0x83); Emit8(0xE0); Emit8(STACK_LEVELS - 1);             // and eax, 15
+                Emit8(0xB9); Emit32(next);                                      // mov ecx, next
+                Emit8(0x66); Emit8(0x89); Emit8(0x8C); Emit8(0x43); Emit32(offStack);  // mov [rbx+rax*2+stack], cx
+                Emit8(0xFE); EmitMem(0, offSp);                                 // inc byte [sp]
+                EmitChainExit(in->nnn);
+                break;
+            case OpId::OP_3xkk:
+            case OpId::OP_4xkk:
+            case OpId::OP_5xy0:
+            case OpId::OP_9xy0:
+            case OpId::OP_Ex9E:
+            case OpId::OP_ExA1:
+            {
+                uint8_t condition = CC_E;
+                switch (in->op) {
+                    case OpId::OP_3xkk:
+                    case OpId::OP_4xkk:
+                        Emit8(0x80); EmitMem(7, vx); Emit8(in->kk);             // cmp byte [Vx], kk
+                        condition = in->op == OpId::OP_3xkk ? CC_E : CC_NE;
+                        break;
+                    case OpId::OP_5xy0:
+                    case OpId::OP_9xy0:
+                        Emit8(0x8A); EmitMem(EAX, vx);                          // mov al, [Vx]
+                        Emit8(0x3A); EmitMem(EAX, vy);                          // cmp al, [Vy]
+                        condition = in->op == OpId::OP_5xy0 ? CC_E : CC_NE;
+                        break;
+                    default:
+                        Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);             // movzx eax, byte [Vx]
+                        Emit8(0x83); Emit8(0xE0); Emit8(KEY_COUNT - 1);        // and eax, 15
+                        Emit8(0x80); Emit8(0xBC); Emit8(0x03); Emit32(offKeypad); Emit8(0);  // cmp byte [rbx+rax+keypad], 0
+                        condition = in->op == OpId::OP_Ex9E ? CC_NE : CC_E;
+                        break;
+                }
+                uint8_t* skipJump = codePtr;
+                EmitJcc(condition, codePtr);
+                EmitChainExit(next);
+                Patch(skipJump + 2, codePtr);
+                EmitChainExit(next + 2);
+            } break;
+            case OpId::OP_6xkk:
+                Emit8(0xC6); EmitMem(0, vx); Emit8(in->kk);                     // mov byte [Vx], kk
+                break;
+            case OpId::OP_7xkk:
+                Emit8(0x80); EmitMem(0, vx); Emit8(in->kk);                     // add byte [Vx], kk
+                break;
+            case OpId::OP_8xy0:
+                Emit8(0x8A); EmitMem(EAX, vy);                                  // mov al, [Vy]
+                Emit8(0x88); EmitMem(EAX, vx);                                  // mov [Vx], al
+                break;
+            case OpId::OP_8xy1:
+            case OpId::OP_8xy2:
+            case OpId::OP_8xy3:
+                Emit8(0x8A); EmitMem(EAX, vy);                                  // mov al, [Vy]
+                Emit8(in->op == OpId::OP_8xy1 ? 0x08 : in->op == OpId::OP_8xy2 ? 0x20 : 0x30);
+                EmitMem(EAX, vx);                                               // or/and/xor [Vx], al
+                break;
+            case OpId::OP_8xy4:
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);                     // movzx eax, byte [Vx]
+                Emit8(0x0F); Emit8(0xB6); EmitMem(ECX, vy);                     // movzx ecx, byte [Vy]
+                Emit8(0x01); Emit8(0xC8);                                       // add eax, ecx
+                Emit8(0x89); Emit8(0xC2);                                       // mov edx, eax
+                Emit8(0xC1); Emit8(0xEA); Emit8(8);                             // shr edx, 8
+                Emit8(0x88); EmitMem(EDX, vf);                                  // mov [VF], dl
+                Emit8(0x88); EmitMem(EAX, vx);                                  // mov [Vx], al
+                break;
+            case OpId::OP_8xy5:
+            case OpId::OP_8xy7:
+            {
+                // VF is written before the subtraction re-reads its operands, as in the interpreter
+                int32_t minuend = in->op == OpId::OP_8xy5 ? vx : vy;
+                int32_t subtrahend = in->op == OpId::OP_8xy5 ? vy : vx;
+                Emit8(0x8A); EmitMem(EAX, minuend);                             // mov al, [a]
+                Emit8(0x3A); EmitMem(EAX, subtrahend);                          // cmp al, [b]
+                Emit8(0x0F); Emit8(0x97); Emit8(0xC0);                          // seta al
+                Emit8(0x88); EmitMem(EAX, vf);                                  // mov [VF], al
+                Emit8(0x8A); EmitMem(EAX, minuend);                             // mov al, [a]
+                Emit8(0x2A); EmitMem(EAX, subtrahend);                          // sub al, [b]
+                Emit8(0x88); EmitMem(EAX, vx);                                  // mov [Vx], al
+            } break;
+            case OpId::OP_8xy6:
+                if (shiftReadsVy) {
+                    Emit8(0x8A); EmitMem(EAX, vy);                              // mov al, [Vy]
+                    Emit8(0x88); EmitMem(EAX, vx);                              // mov [Vx], al
+                }
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);                     // movzx eax, byte [Vx]
+                Emit8(0x83); Emit8(0xE0); Emit8(1);                             // and eax, 1
+                Emit8(0x88); EmitMem(EAX, vf);                                  // mov [VF], al
+                Emit8(0xD0); EmitMem(5, vx);                                    // shr byte [Vx], 1
+                break;
+            case OpId::OP_8xyE:
+                if (shiftReadsVy) {
+                    Emit8(0x8A); EmitMem(EAX, vy);                              // mov al, [Vy]
+                    Emit8(0x88); EmitMem(EAX, vx);                              // mov [Vx], al
+                }
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);                     // movzx eax, byte [Vx]
+                Emit8(0xC1); Emit8(0xE8); Emit8(7);                             // shr eax, 7
+                Emit8(0x88); EmitMem(EAX, vf);                                  // mov [VF], al
+                Emit8(0xD0); EmitMem(4, vx);                                    // shl byte [Vx], 1
+                break;
+            case OpId::OP_Annn:
+                Emit8(0x66); Emit8(0xC7); EmitMem(0, offIndex); Emit16(in->nnn); // mov word [index], nnn
+                break;
+            case OpId::OP_Bnnn:
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, jumpUsesVx ? vx : offRegisters);  // movzx eax, byte [V0 or Vx]
+                Emit8(0x05); Emit32(in->nnn);                                   // add eax, nnn
+                Emit8(0x66); Emit8(0x89); EmitMem(EAX, offPc);                  // mov [pc], ax
+                EmitDynamicExit();
+                break;
+            case OpId::OP_Fx07:
+                Emit8(0x8A); EmitMem(EAX, offDelayTimer);                       // mov al, [delayTimer]
+                Emit8(0x88); EmitMem(EAX, vx);                                  // mov [Vx], al
+                break;
+            case OpId::OP_Fx15:
+            case OpId::OP_Fx18:
+                Emit8(0x8A); EmitMem(EAX, vx);                                  // mov al, [Vx]
+                Emit8(0x88); EmitMem(EAX, in->op == OpId::OP_Fx15 ? offDelayTimer : offSoundTimer);
+                break;
+            case OpId::OP_Fx1E:
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);                     // movzx eax, byte [Vx]
+                Emit8(0x66); Emit8(0x01); EmitMem(EAX, offIndex);               // add [index], ax
+                break;
+            case OpId::OP_Fx29:
+                Emit8(0x0F); Emit8(0xB6); EmitMem(EAX, vx);                     // movzx eax, byte [Vx]
+                Emit8(0x8D); Emit8(0x44); Emit8(0x80); Emit8(FONTSET_START_ADDRESS);  // lea eax, [rax+rax*4+font]
+                Emit8(0x66); Emit8(0x89); EmitMem(EAX, offIndex);               // mov [index], ax
+                break;
+            case OpId::OP_Fx33:
+            case OpId::OP_Fx55:
+                // May overwrite translated code, so always return to the dispatcher
+                EmitCall(in);
+                EmitPlainExit(next);
+                break;
+            case OpId::OP_Fx0A:
+            case OpId::Count:
+                break;
+        }
+
+        translated[pc] = true;
+        translated[pc + 1] = true;
+        pc = next;
+    }
+
+    if (!terminated) {
+        EmitChainExit(pc);
+    }
+
+    // Budget exhausted: undo the reservation and hand the block back to the dispatcher
+    Patch(bailJump + 2, codePtr);
+    Emit8(0x49); Emit8(0x81); Emit8(0xC4); Emit32(length);                      // add r12, length
+    Emit8(0x66); Emit8(0xC7); EmitMem(0, offPc); Emit16(start);                  // mov word [pc], start
+    Emit8(0xB8); Emit32(EXIT_BAIL);                                             // mov eax, EXIT_BAIL
+    EmitJump(exitCommon);
+
+    blocks[start] = entry;
+    idle[start] = chip8.IdleLoopLength(start) > 0;
+    // Idle loop heads are left to the dispatcher, however the block is reached
+    dynamicTargets[start] = idle[start] ? nullptr : entry;
+    return entry;
+}
+
+void Jit::EmitStubs() {
+    static_assert(offsetof(Context, blocks) == 0, "exit stubs expect blocks at offset 0");
+    static_assert(offsetof(Context, budget) == 8, "exit stubs expect budget at offset 8");
+
+    // uintptr_t enter(Chip8* rdi, uint8_t* block rsi, int64_t budget rdx, Context* rcx)
+    enter = reinterpret_cast<EntryFunc>(codePtr);
+    Emit8(0x53);                                                                // push rbx
+    Emit8(0x41); Emit8(0x54);                                                   // push r12
+    Emit8(0x41); Emit8(0x55);                                                   // push r13
+    Emit8(0x48); Emit8(0x89); Emit8(0xFB);                                      // mov rbx, rdi
+    Emit8(0x49); Emit8(0x89); Emit8(0xD4);                                      // mov r12, rdx
+    Emit8(0x49); Emit8(0x89); Emit8(0xCD);                                      // mov r13, rcx
+    Emit8(0xFF); Emit8(0xE6);                                                   // jmp rsi
+
+    exitPlain = codePtr;
+    Emit8(0x31); Emit8(0xC0);                                                   // xor eax, eax
+
+    exitCommon = codePtr;
+    Emit8(0x4D); Emit8(0x89); Emit8(0x65); Emit8(0x08);                         // mov [r13+8], r12
+    Emit8(0x41); Emit8(0x5D);                                                   // pop r13
+    Emit8(0x41); Emit8(0x5C);                                                   // pop r12
+    Emit8(0x5B);                                                                // pop rbx
+    Emit8(0xC3);                                                                // ret
+}
+
+void Jit::Emit8(uint8_t value) {
+    *codePtr++ = value;
+}
+
+void Jit::Emit16(uint16_t value) {
+    std::memcpy(codePtr, &value, sizeof(value));
+    codePtr += sizeof(value);
+}
+
+void Jit::Emit32(uint32_t value) {
+    std::memcpy(codePtr, &value, sizeof(value));
+    codePtr += sizeof(value);
+}
+
+void Jit::Emit64(uint64_t value) {
+    std::memcpy(codePtr, &value, sizeof(value));
+    codePtr += sizeof(value);
+}
+
+void Jit::EmitMem(uint8_t reg, int32_t offset) {
+    // ModRM for [rbx + disp32]
+    Emit8(0x80 | (reg << 3) | 0x3);
+    Emit32(static_cast<uint32_t>(offset));
+}
+
+void Jit::EmitJump(uint8_t const* target) {
+    Emit8(0xE9);
+    Emit32(static_cast<uint32_t>(target - (codePtr + 4)));
+}
+
+void Jit::EmitJcc(uint8_t condition, uint8_t const* target) {
+    Emit8(0x0F);
+    Emit8(0x80 | condition);
+    Emit32(static_cast<uint32_t>(target - (codePtr + 4)));
+}
+
+void Jit::EmitCall(Chip8::Instruction const* in) {
+    Emit8(0x48); Emit8(0x89); Emit8(0xDF);                                      // mov rdi, rbx
+    Emit8(0x48); Emit8(0xBE); Emit64(reinterpret_cast<uint64_t>(in));           // mov rsi, in
+    Emit8(0x48); Emit8(0xB8); Emit64(reinterpret_cast<uint64_t>(&Jit::Execute)); // mov rax, Execute
+    Emit8(0xFF); Emit8(0xD0);                                                   // call rax
+}
+
+void Jit::EmitChainExit(uint16_t target) {
+    // The leading jmp falls through until the dispatcher patches it to the target block
+    uint8_t* site = codePtr;
+    Emit8(0xE9); Emit32(0);                                                     // jmp +0
+    Emit8(0x66); Emit8(0xC7); EmitMem(0, offPc); Emit16(target);                 // mov word [pc], target
+    Emit8(0x48); Emit8(0x8D); Emit8(0x05);                                      // lea rax, [rip + site]
+    Emit32(static_cast<uint32_t>(site - (codePtr + 4)));
+    EmitJump(exitCommon);
+}
+
+void Jit::EmitDynamicExit() {
+    // Look the new pc up in the dynamic target table and jump straight there if it is translated
+    Emit8(0x0F); Emit8(0xB7); EmitMem(EAX, offPc);                              // movzx eax, word [pc]
+    Emit8(0x3D); Emit32(ADDRESS_MASK - 1);                                      // cmp eax, 0xFFE
+    EmitJcc(CC_A, exitPlain);
+    Emit8(0x49); Emit8(0x8B); Emit8(0x4D); Emit8(0x00);                         // mov rcx, [r13 + blocks]
+    Emit8(0x48); Emit8(0x8B); Emit8(0x04); Emit8(0xC1);                         // mov rax, [rcx+rax*8]
+    Emit8(0x48); Emit8(0x85); Emit8(0xC0);                                      // test rax, rax
+    EmitJcc(CC_E, exitPlain);
+    Emit8(0xFF); Emit8(0xE0);                                                   // jmp rax
+}
+
+void Jit::EmitPlainExit(uint16_t target) {
+    Emit8(0x66); Emit8(0xC7); EmitMem(0, offPc); Emit16(target);                 // mov word [pc], target
+    EmitJump(exitPlain);
+}
+
+void Jit::EmitStopCheck(unsigned int refund, uint16_t next) {
+    // The handler requested a stop: retire it, return the unrun part of the reservation and exit
+    Emit8(0x80); EmitMem(7, offStopRequested); Emit8(0);                        // cmp byte [stopRequested], 0
+    uint8_t* continueJump = codePtr;
+    EmitJcc(CC_E, codePtr);
+    if (refund > 0) {
+        Emit8(0x49); Emit8(0x81); Emit8(0xC4); Emit32(refund);                  // add r12, refund
+    }
+    EmitPlainExit(next);
+    Patch(continueJump + 2, codePtr);
+}
+
+void Jit::Patch(uint8_t* site, uint8_t const* target) {
+    // site points at a rel32 field
+    uint32_t rel = static_cast<uint32_t>(target - (site + 4));
+    std::memcpy(site, &rel, sizeof(rel));
+}
+
+int32_t Jit::Offset(void const* member) const {
+    return static_cast<int32_t>(static_cast<uint8_t const*>(member) - reinterpret_cast<uint8_t const*>(&chip8));
+}
+
+#else
+
+Jit::Jit(Chip8& chip8)
+    : chip8(chip8)
+{
+}
+
+Jit::~Jit() = default;
+
+unsigned int Jit::Run(unsigned int count) {
+    return chip8.RunThreaded(count);
+}
+
+void Jit::Invalidate(uint16_t) {}
+
+void Jit::Flush() {}
+
+#endif
+
+unsigned int Chip8::RunJit(unsigned int count) {
+    if (!jit) {
+        jit = std::make_unique<Jit>(*this);
+    }
+
+    if (jit->Available()) {
+        return jit->Run(count);
+    }
+    return RunThreaded(count);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <cstdint>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define CHIP8_JIT_X64 1
+#else
+#define CHIP8_JIT_X64 0
+#endif
+
+// Basic-block recompiler for x86-64 (System V ABI).
+//
+// Guest blocks end at 1nnn/2nnn/00EE/Bnnn, the skip opcodes, and the memory
+// writers Fx33/Fx55. All guest state stays in the owning Chip8 object, which is
+// addressed through a pinned host register, so the interpreter can take over at
+// any block boundary. Fx0A always runs on the interpreter; Dxyn, 00E0, Cxkk and
+// Fx65 call the interpreter's handlers in place, and the draws leave the block
+// early when the batch was asked to stop on them.
+class Jit
+{
+public:
+    explicit Jit(Chip8& chip8);
+    ~Jit();
+    Jit(Jit const&) = delete;
+    Jit& operator=(Jit const&) = delete;
+
+    bool Available() const { return codeStart != nullptr; }
+
+    // Executes count guest instructions, or fewer if a stop condition fires;
+    // returns the number executed
+    unsigned int Run(unsigned int count);
+
+    // Called for every guest memory write; drops all translations if the byte was translated
+    void Invalidate(uint16_t address);
+    void Flush();
+
+private:
+    // Shared with generated code through r13; field offsets are baked into the exit stub
+    struct Context
+    {
+        uint8_t** blocks;
+        int64_t budget;
+    };
+
+    using EntryFunc = uintptr_t (*)(Chip8* chip8, uint8_t* block, int64_t budget, Context* context);
+
+    static void Execute(Chip8* chip8, Chip8::Instruction const* in);
+
+    uint8_t* Translate(uint16_t start);
+    void Chain(uint8_t* site);
+
+    // W^X: the code buffer is read-write while blocks are emitted or patched
+    // and read-execute while they run
+    void Unseal();
+    bool Seal();
+    void Release();
+
+    // Code emission
+    void EmitStubs();
+    void Emit8(uint8_t value);
+    void Emit16(uint16_t value);
+    void Emit32(uint32_t value);
+    void Emit64(uint64_t value);
+    void EmitMem(uint8_t reg, int32_t offset);
+    void EmitJump(uint8_t const* target);
+    void EmitJcc(uint8_t condition, uint8_t const* target);
+    void EmitCall(Chip8::Instruction const* in);
+    void EmitChainExit(uint16_t target);
+    void EmitDynamicExit();
+    void EmitPlainExit(uint16_t target);
+    void EmitStopCheck(unsigned int refund, uint16_t next);
+    void Patch(uint8_t* site, uint8_t const* target);
+    int32_t Offset(void const* member) const;
+
+    Chip8& chip8;
+
+    uint8_t* codeStart{};
+    uint8_t* codeEnd{};
+    uint8_t* codePtr{};
+    uint8_t* blocksStart{};
+    bool writable{};
+
+    // Shared stubs at the start of the code buffer
+    EntryFunc enter{};
+    uint8_t* exitCommon{};
+    uint8_t* exitPlain{};
+
+    Context context{};
+    uint8_t* blocks[MEMORY_SIZE]{};
+    uint8_t* dynamicTargets[MEMORY_SIZE]{};     // blocks without the idle loop heads; looked up by 00EE and Bnnn exits
+    bool translated[MEMORY_SIZE]{};
+    bool idle[MEMORY_SIZE]{};           // Block starts an idle loop; never chained to
+    bool flushPending{};
+
+    // Quirks of the owning instance, baked into translated code
+    bool shiftReadsVy{};
+    bool jumpUsesVx{};
+    unsigned int generation{};
+
+    // Host-relative offsets of the guest state inside Chip8
+    int32_t offRegisters{};
+    int32_t offIndex{};
+    int32_t offPc{};
+    int32_t offSp{};
+    int32_t offStack{};
+    int32_t offDelayTimer{};
+    int32_t offSoundTimer{};
+    int32_t offKeypad{};
+    int32_t offStopRequested{};
+};
@@ -1,25 +1,77 @@
 #pragma once
 
-#include <glad.h>
-#include <SDL.h>
-#include <map>
+#include <cstdint>
 
+// Presentation and input backend, chosen at startup. The emulator only talks
+// to this interface, so headless builds never link or initialise SDL.
 class Platform
 {
 public:
-    Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
-    ~Platform();
-    void Update(void const* buffer, int pitch);
-    bool ProcessInput(uint8_t* keys);
-
-private:
-    SDL_Window* window{};
-    SDL_GLContext gl_context{};
-    GLuint framebuffer_texture{};
-    
-    // Modern OpenGL objects
-    GLuint shaderProgram;
-    GLuint VAO, VBO, EBO;
-
-    std::map<SDL_Keycode, uint8_t> keyMap;
-};
\ No newline at end of file
+    // Presentation traffic, for checking what dirty-row uploads save
+    struct UploadStats
+    {
+        uint64_t framesPresented;
+        uint64_t framesSkipped;     // Nothing changed, so nothing was drawn or swapped
+        uint64_t uploadCalls;
+        uint64_t rowsUploaded;
+        uint64_t bytesUploaded;
+        uint64_t uploadCpuNanoseconds;  // Host time spent in the upload calls, including any wait on the GPU
+        uint64_t uploadGpuNanoseconds;  // GPU time of the timed uploads, from GL_TIME_ELAPSED queries
+        uint64_t uploadGpuSamples;      // Uploads timed; the rest found their slot's last result not yet ready
+        uint64_t fenceWaits;            // Frames whose ring slot was still in use by the GPU
+        uint64_t presentNanoseconds;    // Host time spent presenting frames, not counting waits for the display to refresh
+    };
+
+    virtual ~Platform() = default;
+
+    // Presents the rows set in dirtyRows (bit y for row y); with no dirty rows
+    // the previous frame stays as it is unless the backend needs a redraw.
+    // buffer is a 1-bpp bitplane, leftmost pixel in the most significant bit
+    // of each byte.
+    virtual void Update(void const* buffer, int pitch, uint32_t dirtyRows) = 0;
+
+    // Applies pending input to keys; returns true when the user asked to quit
+    virtual bool ProcessInput(uint8_t* keys) = 0;
+
+    // True when ProcessInput() saw an odd number of turbo hotkey presses since the last call
+    bool TakeTurboToggle()
+    {
+        bool toggled = turboToggled;
+        turboToggled = false;
+        return toggled;
+    }
+
+    virtual void WaitForInput(int timeoutMs) = 0;
+    virtual void Wake() = 0;    // Ends a WaitForInput() early; safe to call from any thread
+
+    // True for backends that must see every changed frame, such as recorders.
+    // Others may be handed only the newest frame when they fall behind.
+    virtual bool PresentsEveryFrame() const
+    {
+        return false;
+    }
+
+    // True when presenting blocks until the display refreshes. WaitForVblank()
+    // then shows the current frame again and returns on the next refresh, so
+    // the render thread can keep time with the display between changed frames.
+    virtual bool HasVsync() const
+    {
+        return false;
+    }
+
+    virtual void WaitForVblank()
+    {
+    }
+
+    // Backend name and configuration, for reports
+    virtual char const* Describe() const = 0;
+
+    UploadStats const& Stats() const
+    {
+        return stats;
+    }
+
+protected:
+    UploadStats stats{};
+    bool turboToggled{};
+};
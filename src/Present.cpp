@@ -0,0 +1,103 @@
+#include "Present.hpp"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 0xRRGGBBAA as the word whose bytes are R, G, B, A in memory on this host
+static uint32_t MemoryOrder(uint32_t color)
+{
+    const uint8_t bytes[4] = {
+        static_cast<uint8_t>(color >> 24), static_cast<uint8_t>(color >> 16),
+        static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color)
+    };
+    uint32_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+// One colour: six or eight hex digits
+static bool ParseColor(char const* text, size_t length, uint32_t& color)
+{
+    if (length != 6 && length != 8) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+        char c = text[i];
+        int digit = c >= '0' && c <= '9' ? c - '0'
+                  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                  : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                  : -1;
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | static_cast<uint32_t>(digit);
+    }
+    color = length == 6 ? (value << 8) | 0xFF : value;
+    return true;
+}
+
+bool ParsePalette(char const* text, Palette& palette)
+{
+    char const* comma = std::strchr(text, ',');
+    if (comma == nullptr) {
+        return false;
+    }
+    Palette parsed;
+    if (!ParseColor(text, comma - text, parsed.foreground) ||
+        !ParseColor(comma + 1, std::strlen(comma + 1), parsed.background)) {
+        return false;
+    }
+    palette = parsed;
+    return true;
+}
+
+#if defined(__SSE2__)
+
+// Each byte is broadcast to four lanes per half, the lanes test one bit each,
+// and the compare result selects between the two colours
+void ExpandBits(uint8_t const* bits, size_t count, uint32_t* pixels, uint32_t on, uint32_t off)
+{
+    const __m128i onWords = _mm_set1_epi32(static_cast<int>(on));
+    const __m128i offWords = _mm_set1_epi32(static_cast<int>(off));
+    const __m128i highBits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i lowBits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+
+    for (size_t i = 0; i < count; ++i) {
+        const __m128i byte = _mm_set1_epi32(bits[i]);
+        const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(byte, highBits), highBits);
+        const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(byte, lowBits), lowBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels),
+                         _mm_or_si128(_mm_and_si128(high, onWords), _mm_andnot_si128(high, offWords)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4),
+                         _mm_or_si128(_mm_and_si128(low, onWords), _mm_andnot_si128(low, offWords)));
+        pixels += 8;
+    }
+}
+
+#else
+
+void ExpandBits(uint8_t const* bits, size_t count, uint32_t* pixels, uint32_t on, uint32_t off)
+{
+    for (size_t i = 0; i < count; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            // Branch-free select, which compilers vectorise where they can
+            uint32_t mask = 0u - ((bits[i] >> bit) & 1u);
+            *pixels++ = (on & mask) | (off & ~mask);
+        }
+    }
+}
+
+#endif
+
+void ExpandToRgba(uint8_t const* bitplane, int width, int height, int pitch, Palette const& palette, uint32_t* pixels)
+{
+    const uint32_t on = MemoryOrder(palette.foreground);
+    const uint32_t off = MemoryOrder(palette.background);
+    for (int y = 0; y < height; ++y) {
+        ExpandBits(bitplane + y * pitch, width / 8, pixels + y * width, on, off);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Colour conversion for frames that are shown or recorded. The core only
+// keeps logical 1-bpp pixels, so a frame that is never presented (headless,
+// skipped or unchanged) never pays for conversion.
+
+// Foreground (pixel set) and background colours, each 0xRRGGBBAA
+struct Palette
+{
+    uint32_t foreground{0xFFFFFFFF};
+    uint32_t background{0x000000FF};
+};
+
+// Parses "RRGGBB,RRGGBB" (foreground, background), each optionally with an
+// alpha byte appended; returns false for anything else
+bool ParsePalette(char const* text, Palette& palette);
+
+// Expands count bytes of MSB-first 1-bpp pixels into count * 8 words: on for
+// set bits, off for clear ones
+void ExpandBits(uint8_t const* bits, size_t count, uint32_t* pixels, uint32_t on, uint32_t off);
+
+// Expands a packed frame to pixels laid out R, G, B, A in memory
+void ExpandToRgba(uint8_t const* bitplane, int width, int height, int pitch, Palette const& palette, uint32_t* pixels);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstring>
+#include <utility>
+
+// Behaviours that differ between CHIP-8 variants. Each policy is a set of
+// compile-time constants; opcode handlers and the threaded core are
+// instantiated once per policy, so a quirk never costs a runtime branch.
+//
+//   shiftReadsVy            8xy6/8xyE shift Vy into Vx instead of shifting Vx in place
+//   loadStoreAdvancesIndex  Fx55/Fx65 leave I pointing past the last register
+//   jumpUsesVx              Bxnn jumps to xnn + Vx instead of nnn + V0
+//   wrapSprites             Dxyn wraps pixels around the screen edges instead of clipping
+
+// Modern interpreters (and this emulator's historical behaviour)
+struct ModernQuirks
+{
+    static constexpr bool shiftReadsVy = false;
+    static constexpr bool loadStoreAdvancesIndex = false;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool wrapSprites = false;
+};
+
+// The original COSMAC VIP interpreter
+struct CosmacQuirks
+{
+    static constexpr bool shiftReadsVy = true;
+    static constexpr bool loadStoreAdvancesIndex = true;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool wrapSprites = false;
+};
+
+// SUPER-CHIP 1.1 on the HP 48
+struct SuperChipQuirks
+{
+    static constexpr bool shiftReadsVy = false;
+    static constexpr bool loadStoreAdvancesIndex = false;
+    static constexpr bool jumpUsesVx = true;
+    static constexpr bool wrapSprites = false;
+};
+
+// XO-CHIP
+struct XoChipQuirks
+{
+    static constexpr bool shiftReadsVy = true;
+    static constexpr bool loadStoreAdvancesIndex = true;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool wrapSprites = true;
+};
+
+// Runtime handle for a quirk policy
+enum class Variant
+{
+    Modern,
+    Cosmac,
+    SuperChip,
+    XoChip
+};
+
+// Calls func with a value of the policy type selected by variant
+template <typename Func>
+decltype(auto) WithQuirks(Variant variant, Func&& func)
+{
+    switch (variant)
+    {
+        case Variant::Cosmac: return std::forward<Func>(func)(CosmacQuirks{});
+        case Variant::SuperChip: return std::forward<Func>(func)(SuperChipQuirks{});
+        case Variant::XoChip: return std::forward<Func>(func)(XoChipQuirks{});
+        case Variant::Modern: break;
+    }
+    return std::forward<Func>(func)(ModernQuirks{});
+}
+
+// Parses a --quirks command-line value; returns false for unknown names
+inline bool ParseVariant(char const* name, Variant& variant)
+{
+    if (std::strcmp(name, "modern") == 0) {
+        variant = Variant::Modern;
+    } else if (std::strcmp(name, "cosmac") == 0) {
+        variant = Variant::Cosmac;
+    } else if (std::strcmp(name, "schip") == 0) {
+        variant = Variant::SuperChip;
+    } else if (std::strcmp(name, "xochip") == 0) {
+        variant = Variant::XoChip;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+// Guest-time events for the batch loop, keyed by the cycle they fire at. Each
+// kind of event has one slot, and the earliest is cached, so the run loop can
+// ask how many cycles it may run flat out before anything needs attention.
+// Periodic devices re-arm themselves when they fire; a new timed device is a
+// new Event plus its handler in Chip8::DispatchEvents().
+class Scheduler
+{
+public:
+    enum Event : unsigned int
+    {
+        TimerTick,      // 60 Hz delay and sound timer decrement
+        VBlank,         // End of a guest frame
+        Input,          // Next entry of the scheduled keypad replay
+        Breakpoint,     // Cycle breakpoint
+        Snapshot,       // Point where the host may save state
+        EVENT_COUNT
+    };
+
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    Scheduler()
+    {
+        for (uint64_t& cycle : due) {
+            cycle = NEVER;
+        }
+    }
+
+    void Schedule(Event event, uint64_t cycle)
+    {
+        due[event] = cycle;
+        Recompute();
+    }
+
+    void Cancel(Event event)
+    {
+        Schedule(event, NEVER);
+    }
+
+    uint64_t When(Event event) const
+    {
+        return due[event];
+    }
+
+    // Cycle of the earliest armed event
+    uint64_t Next() const
+    {
+        return next;
+    }
+
+    // Disarms every event due at or before cycle and returns them, bit e for event e
+    unsigned int TakeDue(uint64_t cycle)
+    {
+        unsigned int fired = 0;
+        for (unsigned int event = 0; event < EVENT_COUNT; ++event) {
+            if (due[event] <= cycle) {
+                due[event] = NEVER;
+                fired |= 1u << event;
+            }
+        }
+        Recompute();
+        return fired;
+    }
+
+private:
+    uint64_t due[EVENT_COUNT];
+    uint64_t next{NEVER};
+
+    // A handful of slots, rescanned only when an event is armed or fires
+    void Recompute()
+    {
+        next = NEVER;
+        for (uint64_t cycle : due) {
+            next = cycle < next ? cycle : next;
+        }
+    }
+};
@@ -0,0 +1,462 @@
+#include "SdlPlatform.hpp"
+#include "Present.hpp"
+#include <glad.h>
+#include <SDL.h>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+// Vertex shader source code
+const char* vertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in vec2 aTexCoord;
+
+    out vec2 TexCoord;
+
+    void main()
+    {
+        gl_Position = vec4(aPos, 1.0);
+        TexCoord = aTexCoord;
+    }
+)";
+
+// Fragment shader source code. The framebuffer texture holds one bit per
+// pixel, eight pixels per texel with the leftmost in the most significant bit.
+const char* fragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec2 TexCoord;
+
+    uniform usampler2D framebuffer;
+    uniform vec4 foreground;
+    uniform vec4 background;
+
+    void main()
+    {
+        ivec2 size = textureSize(framebuffer, 0) * ivec2(8, 1);
+        ivec2 pixel = min(ivec2(TexCoord * vec2(size)), size - 1);
+        uint bits = texelFetch(framebuffer, ivec2(pixel.x >> 3, pixel.y), 0).r;
+        bool on = ((bits >> uint(7 - (pixel.x & 7))) & 1u) != 0u;
+        FragColor = on ? foreground : background;
+    }
+)";
+
+// Default palette: white pixels on black
+const Palette DEFAULT_PALETTE;
+
+// Longest wait for a ring slot before giving up on its fence
+const GLuint64 FENCE_TIMEOUT_NS = 100000000;
+
+// The bundled glad loader stops at GL 3.0; fences (3.2), timer queries (3.3)
+// and immutable buffer storage (4.4) are resolved by hand once a context exists.
+namespace {
+
+const GLenum GL_SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+const GLbitfield GL_SYNC_FLUSH_COMMANDS_BIT = 0x00000001;
+const GLenum GL_TIMEOUT_EXPIRED = 0x911B;
+const GLenum GL_TIME_ELAPSED = 0x88BF;
+const GLbitfield GL_MAP_PERSISTENT_BIT = 0x0040;
+const GLbitfield GL_MAP_COHERENT_BIT = 0x0080;
+
+typedef GLsync (APIENTRYP FenceSyncProc)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRYP ClientWaitSyncProc)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRYP DeleteSyncProc)(GLsync sync);
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+FenceSyncProc fenceSync = nullptr;
+ClientWaitSyncProc clientWaitSync = nullptr;
+DeleteSyncProc deleteSync = nullptr;
+BufferStorageProc bufferStorage = nullptr;
+
+}
+
+SdlPlatform::SdlPlatform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool streamUploads)
+    : textureWidth(textureWidth), textureHeight(textureHeight)
+{
+    SDL_Init(SDL_INIT_VIDEO);
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+    window = SDL_CreateWindow(
+        title,
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        windowWidth, windowHeight,
+        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+
+    gl_context = SDL_GL_CreateContext(window);
+    vsync = SDL_GL_SetSwapInterval(1) == 0;
+    gladLoadGL();
+
+    // Set up modern OpenGL rendering
+    float vertices[] = {
+    // positions         // texture coords
+     1.0f,  1.0f, 0.0f,  1.0f, 0.0f, // top right
+     1.0f, -1.0f, 0.0f,  1.0f, 1.0f, // bottom right
+    -1.0f, -1.0f, 0.0f,  0.0f, 1.0f, // bottom left
+    -1.0f,  1.0f, 0.0f,  0.0f, 0.0f  // top left 
+    };
+    unsigned int indices[] = {
+        0, 1, 3, // first triangle
+        1, 2, 3  // second triangle
+    };
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // Build and compile shader program
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glCompileShader(vertexShader);
+
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
+
+    shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    // Create the framebuffer texture; integer textures cannot be filtered
+    glGenTextures(1, &framebuffer_texture);
+    glBindTexture(GL_TEXTURE_2D, framebuffer_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, textureWidth / 8, textureHeight, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    CreateUploadRing(streamUploads);
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "framebuffer"), 0);
+    SetPalette(DEFAULT_PALETTE.foreground, DEFAULT_PALETTE.background);
+    
+    // Initialize the keymap
+    keyMap = {
+        {SDLK_x, 0x0}, {SDLK_1, 0x1}, {SDLK_2, 0x2}, {SDLK_3, 0x3},
+        {SDLK_q, 0x4}, {SDLK_w, 0x5}, {SDLK_e, 0x6}, {SDLK_a, 0x7},
+        {SDLK_s, 0x8}, {SDLK_d, 0x9}, {SDLK_z, 0xA}, {SDLK_c, 0xB},
+        {SDLK_4, 0xC}, {SDLK_r, 0xD}, {SDLK_f, 0xE}, {SDLK_v, 0xF}
+    };
+}
+
+SdlPlatform::~SdlPlatform()
+{
+    for (int i = 0; i < UPLOAD_RING_SIZE; ++i) {
+        if (uploadFences[i]) {
+            deleteSync(uploadFences[i]);
+        }
+    }
+    glDeleteQueries(UPLOAD_RING_SIZE, uploadQueries);
+    if (uploadPath != UploadPath::Direct) {
+        glDeleteBuffers(UPLOAD_RING_SIZE, uploadBuffers);
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteProgram(shaderProgram);
+    glDeleteTextures(1, &framebuffer_texture);
+    SDL_GL_DeleteContext(gl_context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+void SdlPlatform::SetPalette(uint32_t foreground, uint32_t background)
+{
+    auto channel = [](uint32_t color, int shift) {
+        return ((color >> shift) & 0xFFu) / 255.0f;
+    };
+
+    glUseProgram(shaderProgram);
+    glUniform4f(glGetUniformLocation(shaderProgram, "foreground"),
+                channel(foreground, 24), channel(foreground, 16), channel(foreground, 8), channel(foreground, 0));
+    glUniform4f(glGetUniformLocation(shaderProgram, "background"),
+                channel(background, 24), channel(background, 16), channel(background, 8), channel(background, 0));
+    redrawPending = true;
+}
+
+void SdlPlatform::CreateUploadRing(bool streamUploads)
+{
+    glGenQueries(UPLOAD_RING_SIZE, uploadQueries);
+
+    fenceSync = reinterpret_cast<FenceSyncProc>(SDL_GL_GetProcAddress("glFenceSync"));
+    clientWaitSync = reinterpret_cast<ClientWaitSyncProc>(SDL_GL_GetProcAddress("glClientWaitSync"));
+    deleteSync = reinterpret_cast<DeleteSyncProc>(SDL_GL_GetProcAddress("glDeleteSync"));
+    bufferStorage = reinterpret_cast<BufferStorageProc>(SDL_GL_GetProcAddress("glBufferStorage"));
+    if (!streamUploads || !fenceSync || !clientWaitSync || !deleteSync) {
+        return;
+    }
+
+    // Drivers may hand out entry points they do not implement, so check the version too
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool persistent = bufferStorage != nullptr &&
+        (major > 4 || (major == 4 && minor >= 4) || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage"));
+
+    const GLsizeiptr frameBytes = textureWidth / 8 * textureHeight;
+    const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(UPLOAD_RING_SIZE, uploadBuffers);
+    for (int i = 0; i < UPLOAD_RING_SIZE; ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[i]);
+        if (persistent) {
+            bufferStorage(GL_PIXEL_UNPACK_BUFFER, frameBytes, nullptr, persistentFlags);
+            uploadMapped[i] = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBytes, persistentFlags));
+            persistent = uploadMapped[i] != nullptr;
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes, nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // A failed persistent mapping leaves the buffers usable through per-frame maps
+    if (!persistent) {
+        for (int i = 0; i < UPLOAD_RING_SIZE; ++i) {
+            if (uploadMapped[i]) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[i]);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                uploadMapped[i] = nullptr;
+            }
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    uploadPath = persistent ? UploadPath::Persistent : UploadPath::Streamed;
+}
+
+void SdlPlatform::ReclaimSlot(int slot)
+{
+    if (!uploadFences[slot]) {
+        return;
+    }
+
+    // Normally the GPU finished with this slot frames ago; only block when it has not
+    if (clientWaitSync(uploadFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ++stats.fenceWaits;
+        clientWaitSync(uploadFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    }
+    deleteSync(uploadFences[slot]);
+    uploadFences[slot] = nullptr;
+}
+
+void SdlPlatform::Update(void const* buffer, int pitch, uint32_t dirtyRows)
+{
+    if (dirtyRows == 0 && !redrawPending) {
+        ++stats.framesSkipped;
+        return;
+    }
+    redrawPending = false;
+    const auto presentStart = std::chrono::steady_clock::now();
+
+    if (dirtyRows != 0) {
+        const int slot = uploadSlot;
+        uploadSlot = (uploadSlot + 1) % UPLOAD_RING_SIZE;
+
+        // Collect the timing of this slot's last upload outside the measured section.
+        // Reading a result that is not ready would wait for the GPU, so until it is
+        // the slot's query stays pending and this upload goes untimed.
+        if (queryPending[slot]) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(uploadQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint elapsed = 0;
+                glGetQueryObjectuiv(uploadQueries[slot], GL_QUERY_RESULT, &elapsed);
+                stats.uploadGpuNanoseconds += elapsed;
+                ++stats.uploadGpuSamples;
+                queryPending[slot] = false;
+            }
+        }
+        const bool timed = !queryPending[slot];
+
+        const auto start = std::chrono::steady_clock::now();
+        glBindTexture(GL_TEXTURE_2D, framebuffer_texture);
+        const int rowBytes = textureWidth / 8;
+        auto rows = static_cast<uint8_t const*>(buffer);
+
+        // Uploads read from client memory, or from offsets into the slot's pixel buffer
+        uintptr_t source = reinterpret_cast<uintptr_t>(buffer);
+        if (uploadPath != UploadPath::Direct) {
+            ReclaimSlot(slot);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[slot]);
+
+            uint8_t* staging = uploadMapped[slot];
+            if (uploadPath == UploadPath::Streamed) {
+                staging = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, rowBytes * textureHeight,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+            }
+            for (int y = 0; y < textureHeight; ++y) {
+                if (dirtyRows & (1u << y)) {
+                    std::memcpy(staging + y * rowBytes, rows + y * pitch, rowBytes);
+                }
+            }
+            if (uploadPath == UploadPath::Streamed) {
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            source = 0;
+            pitch = rowBytes;
+        }
+
+        // One upload per run of consecutive dirty rows
+        if (timed) {
+            glBeginQuery(GL_TIME_ELAPSED, uploadQueries[slot]);
+        }
+        int y = 0;
+        while (y < textureHeight) {
+            if (!(dirtyRows & (1u << y))) {
+                ++y;
+                continue;
+            }
+            int first = y;
+            while (y < textureHeight && (dirtyRows & (1u << y))) {
+                ++y;
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, rowBytes, y - first, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                            reinterpret_cast<void const*>(source + first * pitch));
+            ++stats.uploadCalls;
+            stats.rowsUploaded += y - first;
+            stats.bytesUploaded += static_cast<uint64_t>(y - first) * rowBytes;
+        }
+        if (timed) {
+            glEndQuery(GL_TIME_ELAPSED);
+            queryPending[slot] = true;
+        }
+
+        if (uploadPath != UploadPath::Direct) {
+            uploadFences[slot] = fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        stats.uploadCpuNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    ++stats.framesPresented;
+
+    Draw();
+    const auto drawn = std::chrono::steady_clock::now();
+    SDL_GL_SwapWindow(window);
+
+    // With vsync the swap mostly waits for the refresh; without it the swap is where drivers render
+    stats.presentNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        (vsync ? drawn : std::chrono::steady_clock::now()) - presentStart).count();
+}
+
+void SdlPlatform::Draw()
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(shaderProgram);
+    glBindTexture(GL_TEXTURE_2D, framebuffer_texture);
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+bool SdlPlatform::HasVsync() const
+{
+    return vsync;
+}
+
+void SdlPlatform::WaitForVblank()
+{
+    // The back buffer is undefined after a swap, so the texture is drawn again
+    redrawPending = false;
+    Draw();
+    SDL_GL_SwapWindow(window);
+}
+
+bool SdlPlatform::ProcessInput(uint8_t* keys)
+{
+    bool quit = false;
+    SDL_Event event;
+
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+            case SDL_QUIT:
+            {
+                quit = true;
+            } break;
+
+            case SDL_KEYDOWN:
+            {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    quit = true;
+                } else if (event.key.keysym.sym == SDLK_TAB) {
+                    turboToggled ^= !event.key.repeat;
+                } else {
+                    auto it = keyMap.find(event.key.keysym.sym);
+                    if (it != keyMap.end()) {
+                        keys[it->second] = 1;
+                    }
+                }
+            } break;
+
+            case SDL_WINDOWEVENT:
+            {
+                // Exposed or resized; the skipped frames left nothing to show
+                redrawPending = true;
+            } break;
+
+            case SDL_KEYUP:
+            {
+                auto it = keyMap.find(event.key.keysym.sym);
+                if (it != keyMap.end()) {
+                    keys[it->second] = 0;
+                }
+            } break;
+        }
+    }
+    return quit;
+}
+
+void SdlPlatform::WaitForInput(int timeoutMs)
+{
+    // Leaves the event queued for the next ProcessInput()
+    if (timeoutMs > 0) {
+        SDL_WaitEventTimeout(nullptr, timeoutMs);
+    }
+}
+
+void SdlPlatform::Wake()
+{
+    // An empty user event; ProcessInput() drops it
+    SDL_Event event{};
+    event.type = SDL_USEREVENT;
+    SDL_PushEvent(&event);
+}
+
+SdlPlatform::UploadPath SdlPlatform::Path() const
+{
+    return uploadPath;
+}
+
+char const* SdlPlatform::Describe() const
+{
+    switch (uploadPath)
+    {
+        case UploadPath::Streamed: return "SDL/OpenGL, streamed pixel buffers";
+        case UploadPath::Persistent: return "SDL/OpenGL, persistently mapped pixel buffers";
+        case UploadPath::Direct: break;
+    }
+    return "SDL/OpenGL, direct uploads";
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Platform.hpp"
+#include <glad.h>
+#include <SDL.h>
+#include <map>
+
+// Frames in flight between the CPU and the GPU when uploads go through pixel buffers
+const int UPLOAD_RING_SIZE = 3;
+
+// SDL window and input with an OpenGL 3.3 renderer
+class SdlPlatform : public Platform
+{
+public:
+    // How Update() hands texture rows to the driver
+    enum class UploadPath
+    {
+        Direct,         // glTexSubImage2D from client memory; the driver copies, and may stall, inside the call
+        Streamed,       // Ring of pixel buffers mapped unsynchronized each frame, reused only once their fence signals
+        Persistent      // Ring of pixel buffers mapped once (GL 4.4 or ARB_buffer_storage), reused the same way
+    };
+
+    // streamUploads picks the best pixel-buffer path the context supports; false uploads directly
+    SdlPlatform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool streamUploads = true);
+    ~SdlPlatform() override;
+
+    // Uploads the dirty rows and presents; the shader applies the palette.
+    // Skipped frames are redrawn when the window is exposed or resized.
+    void Update(void const* buffer, int pitch, uint32_t dirtyRows) override;
+    bool ProcessInput(uint8_t* keys) override;
+    void WaitForInput(int timeoutMs) override;
+    void Wake() override;
+    bool HasVsync() const override;
+    void WaitForVblank() override;
+    char const* Describe() const override;
+
+    void SetPalette(uint32_t foreground, uint32_t background);    // 0xRRGGBBAA
+    UploadPath Path() const;
+
+private:
+    SDL_Window* window{};
+    SDL_GLContext gl_context{};
+    GLuint framebuffer_texture{};
+    int textureWidth;
+    int textureHeight;
+    bool redrawPending{true};
+    bool vsync{false};
+
+    // Upload ring; slot i is free again once uploadFences[i] has signalled
+    UploadPath uploadPath{UploadPath::Direct};
+    GLuint uploadBuffers[UPLOAD_RING_SIZE]{};
+    uint8_t* uploadMapped[UPLOAD_RING_SIZE]{};
+    GLsync uploadFences[UPLOAD_RING_SIZE]{};
+    GLuint uploadQueries[UPLOAD_RING_SIZE]{};
+    bool queryPending[UPLOAD_RING_SIZE]{};
+    int uploadSlot{};
+
+    void CreateUploadRing(bool streamUploads);
+    void ReclaimSlot(int slot);
+    void Draw();
+    
+    // Modern OpenGL objects
+    GLuint shaderProgram;
+    GLuint VAO, VBO, EBO;
+
+    std::map<SDL_Keycode, uint8_t> keyMap;
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "SpeedController.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+// Frames averaged before each decision; long enough to ride out a single slow frame
+const unsigned int DECISION_FRAMES = 30;
+
+// Share of the frame interval the emulation thread may use before the controller
+// backs off, the share below which it speeds up again, and the share it aims for
+const double HIGH_LOAD = 0.85;
+const double LOW_LOAD = 0.5;
+const double TARGET_LOAD = 0.7;
+
+// Presentation is only worth dropping when it is at least this share of the work
+const double PRESENT_SHARE = 0.1;
+
+// At most every n-th frame is presented under load
+const unsigned int MAX_PRESENT_INTERVAL = 4;
+
+SpeedProfile MakeSpeedProfile(unsigned int targetIps)
+{
+    unsigned int target = std::max(targetIps / SPEED_FRAMES_PER_SECOND, 1u);
+    return {targetIps, std::max(target / 4, 1u), target};
+}
+
+SpeedProfile DefaultSpeedProfile(Variant variant)
+{
+    switch (variant) {
+        case Variant::Cosmac: return MakeSpeedProfile(540);         // About 9 instructions per frame on the VIP
+        case Variant::SuperChip: return MakeSpeedProfile(1800);     // HP 48 interpreters ran much faster
+        case Variant::XoChip: return MakeSpeedProfile(60000);       // XO-CHIP games assume 1000 per frame
+        case Variant::Modern: break;
+    }
+    return MakeSpeedProfile(600);
+}
+
+bool ParseInstructionRange(char const* text, SpeedProfile& profile)
+{
+    char* end = nullptr;
+    unsigned long low = std::strtoul(text, &end, 10);
+    if (end == text || *end != ':') {
+        return false;
+    }
+    char const* second = end + 1;
+    unsigned long high = std::strtoul(second, &end, 10);
+    if (end == second || *end != '\0' || low == 0 || high < low) {
+        return false;
+    }
+    profile.minInstructionsPerFrame = static_cast<unsigned int>(low);
+    profile.maxInstructionsPerFrame = static_cast<unsigned int>(high);
+    return true;
+}
+
+SpeedController::SpeedController(SpeedProfile const& profile, int64_t frameIntervalNs)
+    : profile(profile), frameIntervalNs(frameIntervalNs)
+{
+    const double perFrame = static_cast<double>(profile.targetIps) * frameIntervalNs / 1e9;
+    targetInstructionsPerFrame = std::clamp(static_cast<unsigned int>(perFrame + 0.5),
+                                            profile.minInstructionsPerFrame, profile.maxInstructionsPerFrame);
+    metrics.instructionsPerFrame = targetInstructionsPerFrame;
+    metrics.lowestInstructionsPerFrame = targetInstructionsPerFrame;
+    metrics.presentInterval = 1;
+    metrics.longestPresentInterval = 1;
+}
+
+void SpeedController::EndFrame(int64_t emulateNs, int64_t presentNs, int64_t renderNs)
+{
+    windowEmulateNs += emulateNs;
+    windowPresentNs += presentNs;
+    windowRenderNs += renderNs;
+    if (++windowFrames == DECISION_FRAMES) {
+        Decide();
+        windowFrames = 0;
+        windowEmulateNs = 0;
+        windowPresentNs = 0;
+        windowRenderNs = 0;
+    }
+}
+
+void SpeedController::Decide()
+{
+    const double windowNs = static_cast<double>(frameIntervalNs) * windowFrames;
+    const double work = static_cast<double>(windowEmulateNs + windowPresentNs);
+    const double load = work / windowNs;
+    const double renderLoad = windowRenderNs / windowNs;
+    metrics.load = load;
+    metrics.renderLoad = renderLoad;
+
+    unsigned int& instructions = metrics.instructionsPerFrame;
+    unsigned int& presentInterval = metrics.presentInterval;
+
+    if (load > HIGH_LOAD || renderLoad > HIGH_LOAD) {
+        // Drop presented frames first; the guest keeps its speed
+        const bool presentCostly = renderLoad > HIGH_LOAD || windowPresentNs >= PRESENT_SHARE * work;
+        if (presentInterval < MAX_PRESENT_INTERVAL && presentCostly) {
+            ++presentInterval;
+            ++metrics.presentDrops;
+            metrics.longestPresentInterval = std::max(metrics.longestPresentInterval, presentInterval);
+            return;
+        }
+
+        // Then scale the emulation work down to the target share of the interval,
+        // by at least one instruction and never past the bottom of the range.
+        // Only the emulation thread's own load slows the guest.
+        if (load <= HIGH_LOAD || instructions <= profile.minInstructionsPerFrame) {
+            return;
+        }
+        const double emulateLoad = windowEmulateNs / windowNs;
+        const double budget = std::max(TARGET_LOAD - (load - emulateLoad), TARGET_LOAD / 4);
+        // Clamped as a double: near zero load the quotient overflows unsigned int
+        const double reduced = instructions * budget / std::max(emulateLoad, 1e-9);
+        const unsigned int highest = std::max(profile.minInstructionsPerFrame, instructions - 1);
+        instructions = static_cast<unsigned int>(std::clamp(reduced, static_cast<double>(profile.minInstructionsPerFrame),
+                                                            static_cast<double>(highest)));
+        ++metrics.instructionCuts;
+        metrics.lowestInstructionsPerFrame = std::min(metrics.lowestInstructionsPerFrame, instructions);
+        return;
+    }
+
+    if (load < LOW_LOAD) {
+        // Restore the guest speed first, then the presented frames once both threads have headroom
+        if (instructions < targetInstructionsPerFrame) {
+            const double raised = instructions * TARGET_LOAD / std::max(load, 1e-9);
+            instructions = static_cast<unsigned int>(std::clamp(raised, static_cast<double>(instructions + 1),
+                                                                static_cast<double>(targetInstructionsPerFrame)));
+            ++metrics.instructionRaises;
+        } else if (presentInterval > 1 && renderLoad < LOW_LOAD) {
+            --presentInterval;
+            ++metrics.presentRestores;
+        }
+    }
+}
+
+unsigned int SpeedController::InstructionsPerFrame() const
+{
+    return metrics.instructionsPerFrame;
+}
+
+bool SpeedController::ShouldPresent(uint64_t frame) const
+{
+    return frame % metrics.presentInterval == 0;
+}
+
+SpeedProfile const& SpeedController::Profile() const
+{
+    return profile;
+}
+
+SpeedController::SpeedMetrics const& SpeedController::Metrics() const
+{
+    return metrics;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Quirks.hpp"
+#include <cstdint>
+
+// Guest speed a ROM wants, and how far the controller may stray from it
+struct SpeedProfile
+{
+    unsigned int targetIps;         // Guest instructions per second of wall-clock time
+    unsigned int minInstructionsPerFrame;
+    unsigned int maxInstructionsPerFrame;
+};
+
+// Frames per second the controller paces the guest at; one timer tick each
+const int SPEED_FRAMES_PER_SECOND = 60;
+
+// Profile for a target speed, allowed to slow down to a quarter of it
+SpeedProfile MakeSpeedProfile(unsigned int targetIps);
+
+// Typical speed for ROMs written for each quirk policy
+SpeedProfile DefaultSpeedProfile(Variant variant);
+
+// Parses an "--ipf-range" value, "MIN:MAX", into profile; false on malformed input
+bool ParseInstructionRange(char const* text, SpeedProfile& profile);
+
+// Adapts the instructions per frame to the host. Every few frames it compares
+// the host time the emulation thread spent on them with the frame interval.
+// Under load it first presents fewer frames, and only when that is not enough
+// runs fewer instructions per frame; with headroom it restores the guest
+// speed first and the presented frames after. The render thread runs
+// alongside and never holds up the guest, so its load only sets how many
+// frames are presented.
+class SpeedController
+{
+public:
+    // Decisions so far, for the exit report
+    struct SpeedMetrics
+    {
+        unsigned int instructionsPerFrame;
+        unsigned int presentInterval;   // Every n-th frame is presented
+        unsigned int lowestInstructionsPerFrame;
+        unsigned int longestPresentInterval;
+        uint64_t instructionCuts;
+        uint64_t instructionRaises;
+        uint64_t presentDrops;          // Times presentInterval grew
+        uint64_t presentRestores;
+        double load;                    // Share of the frame interval the emulation thread used in the last window
+        double renderLoad;              // Same for the render thread
+    };
+
+    SpeedController(SpeedProfile const& profile, int64_t frameIntervalNs);
+
+    // Host time the last frame took to emulate and to prepare for presentation on the
+    // emulation thread (zero if it was not presented), and the render thread's
+    // presentation time since the previous frame
+    void EndFrame(int64_t emulateNs, int64_t presentNs, int64_t renderNs);
+
+    unsigned int InstructionsPerFrame() const;
+    bool ShouldPresent(uint64_t frame) const;
+
+    SpeedProfile const& Profile() const;
+    SpeedMetrics const& Metrics() const;
+
+private:
+    SpeedProfile profile;
+    int64_t frameIntervalNs;
+    unsigned int targetInstructionsPerFrame;
+    SpeedMetrics metrics{};
+
+    unsigned int windowFrames{};
+    int64_t windowEmulateNs{};
+    int64_t windowPresentNs{};
+    int64_t windowRenderNs{};
+
+    void Decide();
+};
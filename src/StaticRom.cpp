@@ -0,0 +1,112 @@
+// StaticRom.cpp
+
+#include "StaticRom.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+StaticRom const* linkedRom = nullptr;
+
+}
+
+StaticRom::StaticRom(char const* name, Variant variant, uint8_t const* image, size_t imageSize, Block const* blocks, size_t blockCount, RunFunc run)
+    : name(name), variant(variant), image(image), imageSize(imageSize), blocks(blocks), blockCount(blockCount), run(run)
+{
+    linkedRom = this;
+}
+
+StaticRom const* StaticRom::Linked() {
+    return linkedRom;
+}
+
+void StaticRom::Execute(Chip8& chip8, uint16_t opcode) {
+    Chip8::Instruction const& in = chip8.decodeTable[opcode];
+    (chip8.*in.handler)(in);
+}
+
+StaticCore::StaticCore(Chip8& chip8, StaticRom const& rom)
+    : chip8(chip8), rom(rom), validated(rom.blockCount, 0), chainable(rom.blockCount, 0), idle(rom.blockCount, false)
+{
+    std::fill(std::begin(table), std::end(table), -1);
+
+    for (size_t i = 0; i < rom.blockCount; ++i) {
+        StaticRom::Block const& block = rom.blocks[i];
+        table[block.address] = static_cast<int>(i);
+        for (unsigned int b = 0; b < block.length * 2u; ++b) {
+            covered[(block.address + b) & ADDRESS_MASK] = true;
+        }
+    }
+}
+
+unsigned int StaticCore::Run(unsigned int count) {
+    int64_t remaining = count;
+
+    while (remaining > 0 && !chip8.stopRequested) {
+        if (chip8.waitingForKey) {
+            remaining -= chip8.WaitForKey(static_cast<unsigned int>(remaining));
+            continue;
+        }
+
+        uint16_t pc = chip8.pc;
+        int block = pc < MEMORY_SIZE ? table[pc] : -1;
+
+        if (block >= 0 && Valid(block) && idle[block]) {
+            unsigned int skipped = chip8.SkipIdleLoop(static_cast<unsigned int>(remaining));
+            if (skipped > 0) {
+                remaining -= skipped;
+                continue;
+            }
+        }
+
+        if (block >= 0 && Valid(block)) {
+            remaining = rom.run(chip8, *this, block, remaining);
+        } else {
+            chip8.Cycle();
+            --remaining;
+        }
+    }
+    return count - static_cast<unsigned int>(remaining);
+}
+
+void StaticCore::Invalidate(uint16_t address) {
+    if (covered[address & ADDRESS_MASK]) {
+        ++generation;
+    }
+}
+
+void StaticCore::Reset() {
+    ++generation;
+}
+
+bool StaticCore::Valid(int block) {
+    if (validated[block] == generation) {
+        return true;
+    }
+
+    // Re-check the block against the compiled image after any write to covered code
+    StaticRom::Block const& info = rom.blocks[block];
+    size_t offset = info.address - START_ADDRESS;
+    size_t size = info.length * 2u;
+    if (std::memcmp(&chip8.memory[info.address], &rom.image[offset], size) != 0) {
+        return false;
+    }
+
+    validated[block] = generation;
+    idle[block] = chip8.IdleLoopLength(info.address) > 0;
+    chainable[block] = idle[block] ? 0 : generation;
+    return true;
+}
+
+unsigned int Chip8::RunStatic(unsigned int count) {
+    StaticRom const* rom = StaticRom::Linked();
+    if (rom == nullptr || rom->variant != variant) {
+        return RunThreaded(count);
+    }
+
+    if (!staticCore) {
+        staticCore = std::make_unique<StaticCore>(*this, *rom);
+    }
+    return staticCore->Run(count);
+}
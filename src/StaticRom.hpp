@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class StaticCore;
+
+// A ROM compiled ahead of time by chip8_aot.
+//
+// The generated translation unit defines one function holding every reachable
+// basic block, chained to each other with goto, and registers a single
+// StaticRom at startup. Chip8::RunStatic() enters it at a block and falls back
+// to the interpreter for anything the blocks do not cover:
+// computed jumps into unknown code, Fx0A, and blocks whose bytes no longer match
+// the image the ROM was compiled from. Instances with a different quirk policy
+// than the one the ROM was compiled for run on the threaded core instead.
+class StaticRom
+{
+public:
+    struct Block
+    {
+        uint16_t address;
+        uint16_t length;        // Guest instructions, for the cycle budget
+    };
+
+    // Runs from the start of blocks[block], which the caller has validated,
+    // along every chained block; returns the budget left. A budget shorter
+    // than the block runs just that many of its instructions.
+    using RunFunc = int64_t (*)(Chip8& chip8, StaticCore const& core, int block, int64_t budget);
+
+    StaticRom(char const* name, Variant variant, uint8_t const* image, size_t imageSize, Block const* blocks, size_t blockCount, RunFunc run);
+
+    // The ROM linked into this executable, if any
+    static StaticRom const* Linked();
+
+    char const* name;
+    Variant variant;            // Quirks the blocks were compiled with
+    uint8_t const* image;
+    size_t imageSize;
+    Block const* blocks;
+    size_t blockCount;
+    RunFunc run;
+
+    // Guest state accessors for generated code
+    static uint8_t* Registers(Chip8& chip8) { return chip8.registers; }
+    static uint16_t* Stack(Chip8& chip8) { return chip8.stack; }
+    static uint16_t& Index(Chip8& chip8) { return chip8.index; }
+    static uint16_t& Pc(Chip8& chip8) { return chip8.pc; }
+    static uint8_t& Sp(Chip8& chip8) { return chip8.sp; }
+    static uint8_t& DelayTimer(Chip8& chip8) { return chip8.delayTimer; }
+    static uint8_t& SoundTimer(Chip8& chip8) { return chip8.soundTimer; }
+    static bool Stopping(Chip8 const& chip8) { return chip8.stopRequested; }
+    static void Execute(Chip8& chip8, uint16_t opcode);
+};
+
+// Per-instance runner for the linked StaticRom
+class StaticCore
+{
+public:
+    StaticCore(Chip8& chip8, StaticRom const& rom);
+
+    // Executes count guest instructions, or fewer if a stop condition fires;
+    // returns the number executed
+    unsigned int Run(unsigned int count);
+
+    // Called for every guest memory write; blocks covering the byte are re-checked against the image
+    void Invalidate(uint16_t address);
+    void Reset();
+
+    // Generated code may jump straight into a block that fits the budget, is
+    // still valid and does not head an idle loop; anything else goes back
+    // through Run(), which validates it or skips the loop
+    bool Chainable(int block, unsigned int length, int64_t budget) const
+    {
+        return budget >= length && chainable[block] == generation;
+    }
+
+private:
+    bool Valid(int block);
+
+    Chip8& chip8;
+    StaticRom const& rom;
+
+    int table[MEMORY_SIZE];
+    bool covered[MEMORY_SIZE]{};
+    uint32_t generation{1};
+    std::vector<uint32_t> validated;
+    std::vector<uint32_t> chainable;    // Generation in which the block was validated and found not idle
+    std::vector<bool> idle;     // Block starts an idle loop, as of its last validation
+};
@@ -0,0 +1,304 @@
+#include "TerminalPlatform.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Fastest rate frames are written to the terminal
+const std::chrono::microseconds TERMINAL_FRAME_INTERVAL{16667};
+
+// How long a key stays down after its last press or auto-repeat
+const std::chrono::milliseconds KEY_HOLD_TIME{150};
+
+// Enter the alternate screen, hide the cursor and clear; and the reverse
+const char TERMINAL_SETUP[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+const char TERMINAL_RESTORE[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+// Braille dot for pixel (dx, dy) of a 2x4 cell
+const int BRAILLE_DOTS[4][2] = {
+    {0x01, 0x08},
+    {0x02, 0x10},
+    {0x04, 0x20},
+    {0x40, 0x80}
+};
+
+// Top pixel in bit 0, bottom pixel in bit 1
+const char32_t HALF_BLOCKS[4] = {U' ', U'▀', U'▄', U'█'};
+const char32_t BRAILLE_BLANK = U'⠀';
+
+// Same layout as the SDL keymap: 1234/QWER/ASDF/ZXCV
+static int KeyFor(char c)
+{
+    switch (c) {
+        case 'x': return 0x0;
+        case '1': return 0x1;
+        case '2': return 0x2;
+        case '3': return 0x3;
+        case 'q': return 0x4;
+        case 'w': return 0x5;
+        case 'e': return 0x6;
+        case 'a': return 0x7;
+        case 's': return 0x8;
+        case 'd': return 0x9;
+        case 'z': return 0xA;
+        case 'c': return 0xB;
+        case '4': return 0xC;
+        case 'r': return 0xD;
+        case 'f': return 0xE;
+        case 'v': return 0xF;
+    }
+    return -1;
+}
+
+static void WriteAll(int fd, char const* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+TerminalPlatform::TerminalPlatform(int width, int height, Glyphs glyphs)
+    : glyphs(glyphs)
+{
+    cellWidth = glyphs == Glyphs::Braille ? 2 : 1;
+    cellHeight = glyphs == Glyphs::Braille ? 4 : 2;
+    columns = width / cellWidth;
+    lines = height / cellHeight;
+    shownCells.assign(columns * lines, -1);
+
+    // Worst case: a cursor move and a 3-byte glyph for every cell
+    output.reserve(columns * lines * 12);
+
+    // Raw input: no line buffering, echo or signals, so Ctrl-C arrives as a key
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &savedTermios) == 0) {
+        termios raw = savedTermios;
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+        raw.c_iflag &= ~(IXON | ICRNL);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        rawMode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+
+    // Self-pipe so Wake() can interrupt the poll() in WaitForInput()
+    if (pipe(wakePipe) == 0) {
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+    }
+
+    WriteAll(STDOUT_FILENO, TERMINAL_SETUP, sizeof(TERMINAL_SETUP) - 1);
+}
+
+TerminalPlatform::~TerminalPlatform()
+{
+    WriteAll(STDOUT_FILENO, TERMINAL_RESTORE, sizeof(TERMINAL_RESTORE) - 1);
+    if (rawMode) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedTermios);
+    }
+    for (int fd : wakePipe) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void TerminalPlatform::Update(void const* buffer, int pitch, uint32_t dirtyRows)
+{
+    pendingRows |= dirtyRows;
+    pendingBuffer = buffer;
+    pendingPitch = pitch;
+    if (pendingRows == 0) {
+        ++stats.framesSkipped;
+        return;
+    }
+
+    // Too soon after the last frame; WaitForInput() wakes up in time to write this one
+    const auto now = std::chrono::steady_clock::now();
+    if (now < nextFrameTime) {
+        return;
+    }
+    nextFrameTime = now + TERMINAL_FRAME_INTERVAL;
+
+    Render();
+    const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - now).count();
+    stats.uploadCpuNanoseconds += elapsed;
+    stats.presentNanoseconds += elapsed;
+}
+
+void TerminalPlatform::Render()
+{
+    auto rows = static_cast<uint8_t const*>(pendingBuffer);
+    const uint32_t lineMask = (1u << cellHeight) - 1;
+    int cursorLine = -1;
+    int cursorColumn = -1;
+
+    output.clear();
+    for (int line = 0; line < lines; ++line) {
+        if (!(pendingRows & (lineMask << (line * cellHeight)))) {
+            continue;
+        }
+
+        for (int column = 0; column < columns; ++column) {
+            int bits = CellBits(rows, pendingPitch, column, line);
+            int& shown = shownCells[line * columns + column];
+            if (shown == bits) {
+                continue;
+            }
+            shown = bits;
+
+            // Printing a glyph moves the cursor right, so runs of changed cells need one move
+            if (line != cursorLine || column != cursorColumn) {
+                char move[16];
+                int length = std::snprintf(move, sizeof(move), "\x1b[%d;%dH", line + 1, column + 1);
+                output.append(move, length);
+            }
+            AppendGlyph(bits);
+            cursorLine = line;
+            cursorColumn = column + 1;
+        }
+    }
+
+    if (!output.empty()) {
+        WriteAll(STDOUT_FILENO, output.data(), output.size());
+        ++stats.uploadCalls;
+        stats.bytesUploaded += output.size();
+    }
+    stats.rowsUploaded += __builtin_popcount(pendingRows);
+    ++stats.framesPresented;
+    pendingRows = 0;
+}
+
+int TerminalPlatform::CellBits(uint8_t const* rows, int pitch, int column, int line) const
+{
+    auto pixel = [&](int x, int y) {
+        return (rows[y * pitch + x / 8] >> (7 - x % 8)) & 1;
+    };
+
+    if (glyphs == Glyphs::HalfBlock) {
+        return pixel(column, line * 2) | (pixel(column, line * 2 + 1) << 1);
+    }
+
+    int bits = 0;
+    for (int dy = 0; dy < 4; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            if (pixel(column * 2 + dx, line * 4 + dy)) {
+                bits |= BRAILLE_DOTS[dy][dx];
+            }
+        }
+    }
+    return bits;
+}
+
+void TerminalPlatform::AppendGlyph(int bits)
+{
+    char32_t glyph = glyphs == Glyphs::HalfBlock ? HALF_BLOCKS[bits] : BRAILLE_BLANK + bits;
+    if (glyph < 0x80) {
+        output += static_cast<char>(glyph);
+        return;
+    }
+
+    // Every other glyph is in U+0800 to U+FFFF: three UTF-8 bytes
+    output += static_cast<char>(0xE0 | (glyph >> 12));
+    output += static_cast<char>(0x80 | ((glyph >> 6) & 0x3F));
+    output += static_cast<char>(0x80 | (glyph & 0x3F));
+}
+
+bool TerminalPlatform::ProcessInput(uint8_t* keys)
+{
+    bool quit = false;
+    const auto now = std::chrono::steady_clock::now();
+
+    pollfd input{inputOpen ? STDIN_FILENO : -1, POLLIN, 0};
+    char bytes[64];
+    while (poll(&input, 1, 0) > 0 && (input.revents & POLLIN)) {
+        ssize_t count = read(STDIN_FILENO, bytes, sizeof(bytes));
+        if (count <= 0) {
+            // End of input (stdin redirected); stop polling it
+            inputOpen = count < 0 && errno == EINTR;
+            break;
+        }
+
+        for (ssize_t i = 0; i < count; ++i) {
+            char c = bytes[i];
+            if (c == '\x03') {
+                quit = true;
+            } else if (c == '\t') {
+                turboToggled = !turboToggled;
+            } else if (c == '\x1b') {
+                // A lone Escape quits; escape sequences (arrow keys and the like) are skipped
+                if (i + 1 == count) {
+                    quit = true;
+                } else if (bytes[i + 1] == '[' || bytes[i + 1] == 'O') {
+                    i += 2;
+                    while (i < count && (bytes[i] < 0x40 || bytes[i] > 0x7E)) {
+                        ++i;
+                    }
+                }
+            } else {
+                int key = KeyFor(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+                if (key >= 0) {
+                    keys[key] = 1;
+                    keyReleaseTime[key] = now + KEY_HOLD_TIME;
+                }
+            }
+        }
+    }
+
+    for (int key = 0; key < 16; ++key) {
+        if (keys[key] && keyReleaseTime[key] <= now) {
+            keys[key] = 0;
+        }
+    }
+    return quit;
+}
+
+void TerminalPlatform::WaitForInput(int timeoutMs)
+{
+    // Also wake for a frame held back by the refresh interval and for key releases
+    const auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::milliseconds(timeoutMs);
+    if (pendingRows != 0) {
+        deadline = std::min(deadline, nextFrameTime);
+    }
+    for (auto const& release : keyReleaseTime) {
+        if (release > now) {
+            deadline = std::min(deadline, release);
+        }
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+    if (remaining.count() <= 0) {
+        return;
+    }
+
+    // poll() ignores negative descriptors
+    pollfd fds[2] = {{inputOpen ? STDIN_FILENO : -1, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+    if (poll(fds, 2, static_cast<int>(remaining.count())) > 0 && (fds[1].revents & POLLIN)) {
+        char drain[64];
+        while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+        }
+    }
+}
+
+void TerminalPlatform::Wake()
+{
+    if (wakePipe[1] >= 0) {
+        char byte = 0;
+        (void)!write(wakePipe[1], &byte, 1);
+    }
+}
+
+char const* TerminalPlatform::Describe() const
+{
+    return glyphs == Glyphs::Braille ? "terminal, braille" : "terminal, half blocks";
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Platform.hpp"
+#include <chrono>
+#include <string>
+#include <termios.h>
+#include <vector>
+
+// Draws the display in a terminal with Unicode block or braille characters
+// and reads the keypad from stdin in raw mode; for SSH sessions. Each frame
+// rewrites only the character cells that changed, positioning the cursor
+// with ANSI escapes, and goes out in a single write().
+class TerminalPlatform : public Platform
+{
+public:
+    enum class Glyphs
+    {
+        HalfBlock,  // 1x2 pixels per cell: ' ', U+2580, U+2584, U+2588
+        Braille     // 2x4 pixels per cell: U+2800 to U+28FF
+    };
+
+    TerminalPlatform(int width, int height, Glyphs glyphs);
+    ~TerminalPlatform() override;
+
+    // Frames closer together than the refresh interval are merged into the next one
+    void Update(void const* buffer, int pitch, uint32_t dirtyRows) override;
+
+    // Terminals report key presses but not releases, so a key stays down for
+    // a short hold time after its last press or auto-repeat
+    bool ProcessInput(uint8_t* keys) override;
+    void WaitForInput(int timeoutMs) override;
+    void Wake() override;
+    char const* Describe() const override;
+
+private:
+    Glyphs glyphs;
+    int cellWidth;
+    int cellHeight;
+    int columns;
+    int lines;
+
+    // Glyph shown in each cell, as the pixel bits it covers; -1 before the first frame
+    std::vector<int> shownCells;
+    std::string output;
+
+    // Rows changed since the last frame written, and the frame to write them from
+    uint32_t pendingRows{};
+    void const* pendingBuffer{};
+    int pendingPitch{};
+    std::chrono::steady_clock::time_point nextFrameTime{};
+
+    std::chrono::steady_clock::time_point keyReleaseTime[16]{};
+
+    termios savedTermios{};
+    bool rawMode{false};
+    bool inputOpen{true};
+    int wakePipe[2]{-1, -1};
+
+    void Render();
+    int CellBits(uint8_t const* rows, int pitch, int column, int line) const;
+    void AppendGlyph(int bits);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+
+// Single-producer, single-consumer handoff of the latest value. The producer
+// fills Back() and publishes it; the consumer picks up whatever was published
+// most recently. Three slots mean neither side ever waits for the other:
+// frames the consumer was too slow to see are simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side: the slot to fill, owned by the producer until Publish()
+    T& Back()
+    {
+        return slots[back];
+    }
+
+    void Publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer side: switches Front() to the newest published slot; false if
+    // nothing was published since the last call
+    bool Acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    T const& Front() const
+    {
+        return slots[front];
+    }
+
+private:
+    static constexpr unsigned int INDEX_MASK = 3;
+    static constexpr unsigned int FRESH = 4;
+
+    T slots[3]{};
+
+    // Each index is touched by one thread, except middle; keep them on separate cache lines
+    alignas(64) unsigned int back{0};
+    alignas(64) std::atomic<unsigned int> middle{1};
+    alignas(64) unsigned int front{2};
+};
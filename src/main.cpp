@@ -1,54 +1,562 @@
 #include "Chip8.hpp"
-#include "Platform.hpp"
-#include <chrono>
-#include <iostream>
-
-#include "Chip8.hpp"
-#include "Platform.hpp"
+#include "FramePacer.hpp"
+#include "HeadlessPlatform.hpp"
+#include "SpeedController.hpp"
+#include "TerminalPlatform.hpp"
+#include "TripleBuffer.hpp"
+#if CHIP8_WITH_SDL
+#include "SdlPlatform.hpp"
+#endif
+#include <atomic>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <stdexcept>
+#include <thread>
 
 // Number of required command-line arguments
 const int REQUIRED_ARGS = 4;
 
-void runEmulator(const char* romFilename, int videoScale, int cycleDelay)
+// Instructions per guest frame (1/60 s, one timer tick) unless --ipf is given
+const unsigned int cyclesPerFrame = 10;
+
+// A completed frame, handed from the emulation thread to the render thread
+struct Frame
 {
-    Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT);
-    Chip8 chip8;
+    uint8_t bitplane[VIDEO_WIDTH / 8 * VIDEO_HEIGHT];
+};
+
+// Longest the render thread sleeps without a new frame or input
+const int renderWaitMs = 100;
+
+// In turbo mode without --frameskip, frames are presented at most this often
+const std::chrono::microseconds turboPresentInterval{16667};
+
+// Presentation backends selectable with --platform
+enum class PlatformKind
+{
+    Sdl,
+    Null,
+    File,
+    Terminal
+};
+
+#if CHIP8_WITH_SDL
+const PlatformKind defaultPlatform = PlatformKind::Sdl;
+#else
+const PlatformKind defaultPlatform = PlatformKind::Null;
+#endif
+
+// Parses a positive decimal count such as a --frames value; false on anything else.
+// strtoull alone would accept signs, leading blanks and trailing garbage.
+bool parseCount(char const* text, uint64_t& count)
+{
+    if (!std::isdigit(static_cast<unsigned char>(*text)))
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    count = std::strtoull(text, &end, 10);
+    return *end == '\0' && errno == 0 && count > 0;
+}
+
+// frameLimit stops the run after that many guest frames; 0 runs until the user quits.
+// turbo starts the guest unpaced; frameSkip then presents every frameSkip-th frame,
+// or 0 presents frames as wall-clock time allows.
+// With a speedProfile, frames are paced at 60 Hz and the adaptive controller picks the
+// instructions per frame; cycleDelay and instructionsPerFrame are then ignored.
+// Statistics go to report, to be printed once the platform has released the terminal.
+void runEmulator(std::ostream& report, Platform& platform, const char* romFilename, int cycleDelay, FramePacer::Mode pacing,
+                 Chip8::Core core, Variant variant, unsigned int instructionsPerFrame, uint64_t frameLimit,
+                 bool turbo, unsigned int frameSkip, SpeedProfile const* speedProfile)
+{
+    Chip8 chip8(variant);
     chip8.LoadROM(romFilename);
+    chip8.SetCore(core);
 
-    const int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
-    auto lastCycleTime = std::chrono::high_resolution_clock::now();
-    bool quit = false;
+    int64_t frameIntervalNs = static_cast<int64_t>(cycleDelay) * 1000000;
+    std::unique_ptr<SpeedController> speed;
+    if (speedProfile)
+    {
+        frameIntervalNs = 1000000000 / SPEED_FRAMES_PER_SECOND;
+        speed = std::make_unique<SpeedController>(*speedProfile, frameIntervalNs);
+        instructionsPerFrame = speed->InstructionsPerFrame();
+    }
+    chip8.SetInstructionsPerFrame(instructionsPerFrame);
 
-    while (!quit)
+    const int videoPitch = VIDEO_WIDTH / 8;
+    TripleBuffer<Frame> frames;
+    std::atomic<uint16_t> sharedKeys{};     // Bit k for key k
+    std::atomic<bool> quit{false};
+    std::atomic<bool> turboOn{turbo};
+    std::atomic<uint64_t> renderPresentNs{};    // Platform::Stats().presentNanoseconds, as of the render thread's last Update()
+    uint64_t framesEmulated = 0;
+    uint64_t framesPublished = 0;
+    uint64_t framesRedrawnUnchanged = 0;
+    uint64_t framesNotPresented = 0;
+    uint64_t turboFrames = 0;
+    uint64_t turboFramesSkipped = 0;
+    uint64_t turboInstructions = 0;
+    std::chrono::steady_clock::duration turboTime{};
+
+    // Recording backends see every changed frame, so they are fed here and never through the triple buffer
+    const bool everyFrame = platform.PresentsEveryFrame();
+
+    // Vsync-locked pacing needs a display that blocks on refresh; fall back to the clock without one
+    const bool vsyncMissing = pacing == FramePacer::Mode::VsyncLocked && !platform.HasVsync();
+    if (vsyncMissing)
+    {
+        pacing = FramePacer::Mode::LowLatency;
+    }
+    const bool vsyncLocked = pacing == FramePacer::Mode::VsyncLocked;
+    FramePacer pacer(pacing, frameIntervalNs);
+    const auto runStart = std::chrono::steady_clock::now();
+
+    // Emulation thread: guest timing follows the pacer and never waits on the display,
+    // except for the refresh signal in vsync-locked mode
+    std::thread emulation([&]
     {
-        quit = platform.ProcessInput(chip8.keypad);
+        uint64_t publishedHash = ~chip8.VideoHash();
+        uint8_t recorded[sizeof(Frame::bitplane)];
+        uint16_t appliedKeys = 0;
+        bool wasTurbo = false;
+        uint64_t renderPresentNsSeen = 0;
+        uint64_t turboStartInstructions = 0;
+        auto turboStart = std::chrono::steady_clock::now();
+        auto nextPresentTime = turboStart;
+
+        while (!quit.load(std::memory_order_relaxed))
+        {
+            const bool fast = turboOn.load(std::memory_order_relaxed);
+            if (fast != wasTurbo)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if (fast)
+                {
+                    turboStart = now;
+                    turboStartInstructions = chip8.InstructionCount();
+                }
+                else
+                {
+                    turboTime += now - turboStart;
+                    turboInstructions += chip8.InstructionCount() - turboStartInstructions;
+                    pacer.Resync();
+                }
+                wasTurbo = fast;
+            }
+
+            // One load per frame; the keypad is only rewritten when a key changed
+            const uint16_t keyMask = sharedKeys.load(std::memory_order_relaxed);
+            if (keyMask != appliedKeys)
+            {
+                for (unsigned int key = 0; key < KEY_COUNT; ++key)
+                {
+                    chip8.keypad[key] = (keyMask >> key) & 1u;
+                }
+                appliedKeys = keyMask;
+            }
+
+            const auto frameStart = speed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+            chip8.RunUntilFrame();
+            const auto frameRun = speed ? std::chrono::steady_clock::now() : frameStart;
+            ++framesEmulated;
+            if (framesEmulated == frameLimit)
+            {
+                quit = true;
+                platform.Wake();
+            }
+
+            // Turbo, and the speed controller under load, present only some frames. The others skip
+            // all presentation work, dirty rows included, and the next presented frame picks up
+            // everything they changed.
+            bool present = true;
+            if (fast)
+            {
+                ++turboFrames;
+                if (frameSkip > 0)
+                {
+                    present = framesEmulated % frameSkip == 0;
+                }
+                else
+                {
+                    const auto now = std::chrono::steady_clock::now();
+                    present = now >= nextPresentTime;
+                    if (present)
+                    {
+                        nextPresentTime = now + turboPresentInterval;
+                    }
+                }
+                if (!present)
+                {
+                    ++turboFramesSkipped;
+                }
+            }
+            else if (speed && !speed->ShouldPresent(framesEmulated))
+            {
+                present = false;
+                ++framesNotPresented;
+            }
+
+            // Unchanged frames are not published; the render thread keeps showing the last one.
+            // Rows can be drawn and erased again within a frame, so dirty rows only say the hash is worth computing.
+            if (present && chip8.TakeDirtyRows() != 0)
+            {
+                const uint64_t hash = chip8.VideoHash();
+                if (hash != publishedHash)
+                {
+                    publishedHash = hash;
+                    ++framesPublished;
+                    if (everyFrame)
+                    {
+                        chip8.PackVideo(recorded);
+                        platform.Update(recorded, videoPitch, ~0u);
+                    }
+                    else
+                    {
+                        chip8.PackVideo(frames.Back().bitplane);
+                        frames.Publish();
+                        platform.Wake();
+                    }
+                }
+                else
+                {
+                    ++framesRedrawnUnchanged;
+                }
+            }
+
+            if (fast)
+            {
+                continue;
+            }
+
+            if (speed)
+            {
+                // Presentation costs this thread the hashing and packing above, and the render
+                // thread whatever it spent in Platform::Update() since the last frame
+                const auto frameEnd = std::chrono::steady_clock::now();
+                const uint64_t renderNs = renderPresentNs.load(std::memory_order_relaxed);
+                speed->EndFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(frameRun - frameStart).count(),
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(frameEnd - frameRun).count(),
+                                static_cast<int64_t>(renderNs - renderPresentNsSeen));
+                renderPresentNsSeen = renderNs;
+                if (speed->InstructionsPerFrame() != chip8.InstructionsPerFrame())
+                {
+                    chip8.SetInstructionsPerFrame(speed->InstructionsPerFrame());
+                }
+            }
+            pacer.WaitForFrame();
+        }
+
+        if (wasTurbo)
+        {
+            turboTime += std::chrono::steady_clock::now() - turboStart;
+            turboInstructions += chip8.InstructionCount() - turboStartInstructions;
+        }
+    });
 
-        const auto currentTime = std::chrono::high_resolution_clock::now();
-        const auto timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastCycleTime);
+    // Render thread (this one, which owns the window and GL context): input,
+    // uploads and the vsync-blocked swap. For recording backends it only handles input.
+    uint8_t keys[KEY_COUNT]{};
+    uint8_t shown[sizeof(Frame::bitplane)]{};
+    uint32_t staleRows = ~0u;
 
-        if (timeElapsed.count() > cycleDelay)
+    while (!quit.load(std::memory_order_relaxed))
+    {
+        if (platform.ProcessInput(keys))
+        {
+            quit = true;
+        }
+        if (platform.TakeTurboToggle())
         {
-            lastCycleTime = currentTime;
-            
-            // Execute multiple cycles per frame
-            for (int i = 0; i < cyclesPerFrame; ++i) {
-                chip8.Cycle();
+            turboOn = !turboOn.load(std::memory_order_relaxed);
+        }
+        uint16_t keyMask = 0;
+        for (unsigned int key = 0; key < KEY_COUNT; ++key)
+        {
+            keyMask |= (keys[key] ? 1u : 0u) << key;
+        }
+        sharedKeys.store(keyMask, std::memory_order_relaxed);
+
+        // Frames may have been skipped since the last one shown, so diff against what the texture holds
+        uint32_t dirtyRows = 0;
+        if (!everyFrame && frames.Acquire())
+        {
+            const uint8_t* bitplane = frames.Front().bitplane;
+            for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+            {
+                if (std::memcmp(shown + y * videoPitch, bitplane + y * videoPitch, videoPitch) != 0)
+                {
+                    dirtyRows |= 1u << y;
+                }
+            }
+            dirtyRows |= staleRows;
+            staleRows = 0;
+            std::memcpy(shown, bitplane, sizeof(shown));
+        }
+        if (vsyncLocked)
+        {
+            // Every pass ends in exactly one swap, and each swap lets the guest run a frame
+            if (dirtyRows != 0)
+            {
+                platform.Update(shown, videoPitch, dirtyRows);
+                renderPresentNs.store(platform.Stats().presentNanoseconds, std::memory_order_relaxed);
+            }
+            else
+            {
+                platform.WaitForVblank();
             }
+            pacer.Vblank();
+            continue;
+        }
 
-            platform.Update(chip8.video, videoPitch);
+        if (!everyFrame)
+        {
+            platform.Update(shown, videoPitch, dirtyRows);
+            renderPresentNs.store(platform.Stats().presentNanoseconds, std::memory_order_relaxed);
+        }
+
+        if (dirtyRows == 0)
+        {
+            platform.WaitForInput(renderWaitMs);
         }
     }
+    pacer.Stop();
+    emulation.join();
+    const double runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+    const Platform::UploadStats& stats = platform.Stats();
+    const uint64_t fullFrameBytes = sizeof(uint32_t) * VIDEO_WIDTH * VIDEO_HEIGHT * framesEmulated;
+    report << "Guest: " << chip8.InstructionCount() << " instructions, " << chip8.FrameCount() << " frames at "
+              << chip8.InstructionsPerFrame() << " instructions per frame\n";
+    report << "Frames: " << framesEmulated << " emulated, " << framesPublished << " changed, "
+              << framesRedrawnUnchanged << " drawn but identical, "
+              << stats.framesPresented << " presented\n"
+              << "Texture uploads: " << stats.uploadCalls << " calls, " << stats.rowsUploaded << " rows, "
+              << stats.bytesUploaded << " bytes (" << (fullFrameBytes > 0 ? 100 * stats.bytesUploaded / fullFrameBytes : 0)
+              << "% of full-frame RGBA uploads)\n";
+    // Per-upload timings: CPU time includes any stall waiting on the GPU
+    const uint64_t uploadFrames = stats.framesPresented > 0 ? stats.framesPresented : 1;
+    const uint64_t gpuSamples = stats.uploadGpuSamples > 0 ? stats.uploadGpuSamples : 1;
+    report << "Platform: " << platform.Describe() << ", "
+              << stats.uploadCpuNanoseconds / uploadFrames << " ns CPU per frame, "
+              << stats.uploadGpuNanoseconds / gpuSamples << " ns GPU per timed upload ("
+              << stats.uploadGpuSamples << " timed), "
+              << stats.fenceWaits << " fence waits\n";
+
+    const FramePacer::PacingStats& paced = pacer.Stats();
+    const uint64_t pacedFrames = paced.frames > 0 ? paced.frames : 1;
+    report << "Pacing: " << pacer.Describe() << (vsyncMissing ? " (display has no vsync)" : "") << ", jitter "
+              << paced.jitterTotalNs / pacedFrames / 1000 << " us mean, "
+              << pacer.JitterPercentileNs(0.99) / 1000 << " us p99, "
+              << paced.jitterMaxNs / 1000 << " us max, "
+              << paced.overruns << " overruns, "
+              << paced.spinNs / pacedFrames / 1000 << " us spinning per frame\n";
+
+    if (speed)
+    {
+        const SpeedProfile& profile = speed->Profile();
+        const SpeedController::SpeedMetrics& decisions = speed->Metrics();
+        report << "Speed: target " << profile.targetIps << " IPS, achieved "
+                  << static_cast<uint64_t>(runSeconds > 0 ? chip8.InstructionCount() / runSeconds : 0) << " IPS, "
+                  << decisions.instructionsPerFrame << " instructions per frame (range " << profile.minInstructionsPerFrame
+                  << "-" << profile.maxInstructionsPerFrame << ", lowest " << decisions.lowestInstructionsPerFrame << "), "
+                  << decisions.instructionCuts << " cuts, " << decisions.instructionRaises << " raises, "
+                  << "presenting every " << decisions.presentInterval << " frames (longest " << decisions.longestPresentInterval << "), "
+                  << framesNotPresented << " not presented, load " << static_cast<int>(decisions.load * 100) << "% emulation, "
+                  << static_cast<int>(decisions.renderLoad * 100) << "% render\n";
+    }
+
+    if (turboFrames > 0)
+    {
+        const double turboSeconds = std::chrono::duration<double>(turboTime).count();
+        report << "Turbo: " << turboFrames << " frames, " << turboFramesSkipped << " not presented, "
+                  << static_cast<uint64_t>(turboSeconds > 0 ? turboInstructions / turboSeconds / 1e6 : 0) << " guest MIPS\n";
+    }
 }
 
 int main(int argc, char** argv)
 {
-    if (argc != REQUIRED_ARGS)
+    if (argc < REQUIRED_ARGS)
+    {
+        std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM> [--core=interpreter|threaded|cached|jit] [--quirks=auto|modern|cosmac|schip|xochip] [--upload=pbo|direct] [--platform=sdl|null|file:PATH|terminal|terminal:braille] [--palette=RRGGBB,RRGGBB] [--ipf=N] [--pacing=power|low-latency|vsync] [--turbo] [--frameskip=K] [--ips=auto|N] [--ipf-range=MIN:MAX] [--frames=N]\n";
+        return EXIT_FAILURE;
+    }
+
+    Chip8::Core core = Chip8::Core::Interpreter;
+    const char* romFilename = argv[3];
+    Variant variant = Chip8::DetectVariant(romFilename);
+    bool streamUploads = true;
+    PlatformKind platformKind = defaultPlatform;
+    const char* outputFilename = nullptr;
+    TerminalPlatform::Glyphs glyphs = TerminalPlatform::Glyphs::HalfBlock;
+    Palette palette;
+    unsigned int instructionsPerFrame = cyclesPerFrame;
+    FramePacer::Mode pacing = FramePacer::Mode::LowLatency;
+    bool turbo = false;
+    unsigned int frameSkip = 0;
+    bool adaptiveSpeed = false;
+    unsigned int targetIps = 0;
+    const char* instructionRange = nullptr;
+    bool fixedInstructions = false;
+    uint64_t frameLimit = 0;
+
+    for (int i = REQUIRED_ARGS; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--core=interpreter") == 0)
+        {
+            core = Chip8::Core::Interpreter;
+        }
+        else if (std::strcmp(argv[i], "--core=threaded") == 0)
+        {
+            core = Chip8::Core::Threaded;
+        }
+        else if (std::strcmp(argv[i], "--core=cached") == 0)
+        {
+            core = Chip8::Core::Cached;
+        }
+        else if (std::strcmp(argv[i], "--core=jit") == 0)
+        {
+            core = Chip8::Core::Jit;
+        }
+        else if (std::strcmp(argv[i], "--quirks=auto") == 0)
+        {
+            variant = Chip8::DetectVariant(romFilename);
+        }
+        else if (std::strncmp(argv[i], "--quirks=", 9) == 0)
+        {
+            if (!ParseVariant(argv[i] + 9, variant))
+            {
+                std::cerr << "Unknown quirks: " << argv[i] + 9 << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--upload=pbo") == 0)
+        {
+            streamUploads = true;
+        }
+        else if (std::strcmp(argv[i], "--upload=direct") == 0)
+        {
+            streamUploads = false;
+        }
+        else if (std::strcmp(argv[i], "--platform=sdl") == 0)
+        {
+            platformKind = PlatformKind::Sdl;
+        }
+        else if (std::strcmp(argv[i], "--platform=null") == 0)
+        {
+            platformKind = PlatformKind::Null;
+        }
+        else if (std::strncmp(argv[i], "--platform=file:", 16) == 0 && argv[i][16] != '\0')
+        {
+            platformKind = PlatformKind::File;
+            outputFilename = argv[i] + 16;
+        }
+        else if (std::strcmp(argv[i], "--platform=terminal") == 0)
+        {
+            platformKind = PlatformKind::Terminal;
+            glyphs = TerminalPlatform::Glyphs::HalfBlock;
+        }
+        else if (std::strcmp(argv[i], "--platform=terminal:braille") == 0)
+        {
+            platformKind = PlatformKind::Terminal;
+            glyphs = TerminalPlatform::Glyphs::Braille;
+        }
+        else if (std::strncmp(argv[i], "--palette=", 10) == 0)
+        {
+            if (!ParsePalette(argv[i] + 10, palette))
+            {
+                std::cerr << "Invalid palette: " << argv[i] + 10 << " (expected RRGGBB,RRGGBB)\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strncmp(argv[i], "--ipf=", 6) == 0)
+        {
+            instructionsPerFrame = static_cast<unsigned int>(std::strtoul(argv[i] + 6, nullptr, 10));
+            fixedInstructions = true;
+            if (instructionsPerFrame == 0)
+            {
+                std::cerr << "Invalid instructions per frame: " << argv[i] + 6 << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--pacing=power") == 0)
+        {
+            pacing = FramePacer::Mode::PowerSaving;
+        }
+        else if (std::strcmp(argv[i], "--pacing=low-latency") == 0)
+        {
+            pacing = FramePacer::Mode::LowLatency;
+        }
+        else if (std::strcmp(argv[i], "--pacing=vsync") == 0)
+        {
+            pacing = FramePacer::Mode::VsyncLocked;
+        }
+        else if (std::strcmp(argv[i], "--turbo") == 0)
+        {
+            turbo = true;
+        }
+        else if (std::strncmp(argv[i], "--frameskip=", 12) == 0)
+        {
+            uint64_t skip = 0;
+            if (!parseCount(argv[i] + 12, skip) || skip > UINT_MAX)
+            {
+                std::cerr << "Invalid frame skip: " << argv[i] + 12 << "\n";
+                return EXIT_FAILURE;
+            }
+            frameSkip = static_cast<unsigned int>(skip);
+        }
+        else if (std::strcmp(argv[i], "--ips=auto") == 0)
+        {
+            adaptiveSpeed = true;
+        }
+        else if (std::strncmp(argv[i], "--ips=", 6) == 0)
+        {
+            adaptiveSpeed = true;
+            targetIps = static_cast<unsigned int>(std::strtoul(argv[i] + 6, nullptr, 10));
+            if (targetIps == 0)
+            {
+                std::cerr << "Invalid instructions per second: " << argv[i] + 6 << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strncmp(argv[i], "--ipf-range=", 12) == 0)
+        {
+            adaptiveSpeed = true;
+            instructionRange = argv[i] + 12;
+        }
+        else if (std::strncmp(argv[i], "--frames=", 9) == 0)
+        {
+            if (!parseCount(argv[i] + 9, frameLimit))
+            {
+                std::cerr << "Invalid frame count: " << argv[i] + 9 << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The ROM's profile, overridden by --ips and --ipf-range
+    SpeedProfile speedProfile = targetIps > 0 ? MakeSpeedProfile(targetIps) : DefaultSpeedProfile(variant);
+    if (adaptiveSpeed && fixedInstructions)
     {
-        std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
+        std::cerr << "--ipf fixes the speed; it cannot be combined with --ips or --ipf-range\n";
+        return EXIT_FAILURE;
+    }
+    if (instructionRange && !ParseInstructionRange(instructionRange, speedProfile))
+    {
+        std::cerr << "Invalid instruction range: " << instructionRange << " (expected MIN:MAX)\n";
         return EXIT_FAILURE;
     }
 
@@ -71,8 +579,55 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    const char* romFilename = argv[3];
-    runEmulator(romFilename, videoScale, cycleDelay);
+    // Only the SDL backend initialises SDL; headless backends never touch it
+    std::unique_ptr<Platform> platform;
+    switch (platformKind)
+    {
+        case PlatformKind::Sdl:
+#if CHIP8_WITH_SDL
+        {
+            auto sdl = std::make_unique<SdlPlatform>("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale,
+                                                     VIDEO_WIDTH, VIDEO_HEIGHT, streamUploads);
+            sdl->SetPalette(palette.foreground, palette.background);
+            platform = std::move(sdl);
+        }
+#else
+            (void)videoScale;
+            (void)streamUploads;
+            std::cerr << "Built without SDL; use --platform=null, file:PATH or terminal\n";
+            return EXIT_FAILURE;
+#endif
+            break;
+
+        case PlatformKind::Null:
+            platform = std::make_unique<NullPlatform>();
+            break;
+
+        case PlatformKind::File:
+        {
+            // .pam records colour through the palette; anything else records the 1-bpp frames
+            const size_t nameLength = std::strlen(outputFilename);
+            const bool rgba = nameLength >= 4 && std::strcmp(outputFilename + nameLength - 4, ".pam") == 0;
+            auto file = std::make_unique<FilePlatform>(outputFilename, VIDEO_WIDTH, VIDEO_HEIGHT,
+                                                       rgba ? FilePlatform::Format::Rgba : FilePlatform::Format::Bitmap, palette);
+            if (!file->IsOpen())
+            {
+                std::cerr << "Cannot open " << outputFilename << " for writing\n";
+                return EXIT_FAILURE;
+            }
+            platform = std::move(file);
+        } break;
+
+        case PlatformKind::Terminal:
+            platform = std::make_unique<TerminalPlatform>(VIDEO_WIDTH, VIDEO_HEIGHT, glyphs);
+            break;
+    }
+
+    std::ostringstream report;
+    runEmulator(report, *platform, romFilename, cycleDelay, pacing, core, variant, instructionsPerFrame, frameLimit, turbo, frameSkip,
+                adaptiveSpeed ? &speedProfile : nullptr);
+    platform.reset();
+    std::cout << report.str();
 
     return 0;
 }
\ No newline at end of file